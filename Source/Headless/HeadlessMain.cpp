@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "Defines.h"
+#include "Game.h"
+#include "City.h"
+#include "Draw.h"
+#include "Interface.h"
+#include "Simulation.h"
+#include "Strings.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "NullPlatform.h"
+
+// Runs the game with the null platform layer as fast as possible and reports the frame rate.
+// 'tick' mode runs the whole frame (simulation, input, interface and drawing) whereas
+// 'simulate' mode only advances the simulation. 'month' mode runs whole months with SimulateMonth
+
+enum RunMode
+{
+	RunMode_Tick,
+	RunMode_Simulate,
+	RunMode_Month
+};
+
+void PrintUsage()
+{
+	printf("Usage: microcity_headless [options]\n");
+	printf("  --frames N       Number of frames to run (default 100000)\n");
+	printf("  --mode MODE      'tick' runs TickGame, 'simulate' only runs Simulate (default tick)\n");
+#ifdef USE_MONTH_SIMULATION
+	printf("                   'month' runs SimulateMonth and counts each month as a frame\n");
+	printf("  --threads N      Threads for 'month' mode (default one per hardware thread)\n");
+#endif
+#ifdef USE_FAST_FORWARD
+	printf("  --fast-forward N Instead of running frames, fast forward N years dismissing any fires or budgets\n");
+#endif
+#ifdef USE_SIMULATION_SCHEDULER
+	printf("  --budget US      Give the simulation a budget of US microseconds a frame in 'tick' mode\n");
+	printf("  --steps N        Steps to run a frame with a budget, 0 for as many as fit (default 1)\n");
+#endif
+#ifdef USE_ZONE_SCHEDULER
+	printf("  --zone-schedule S 'exact' scores every zone every month, 'settled' scores settled zones less often\n");
+#endif
+	printf("  --load FILE      Load a saved city instead of starting a new one\n");
+	printf("  --save FILE      Save the city when finished\n");
+	printf("  --terrain N      Terrain type for a new city (0-%d)\n", NUM_TERRAIN_TYPES - 1);
+#ifdef USE_COUNTER_RNG
+	printf("  --seed N         Random seed for a new city, 0 for the LFSR (default %u)\n", DEFAULT_CITY_SEED);
+#endif
+#ifdef ENABLE_TRACING
+	printf("  --trace FILE     Write the recorded trace zones as a Chrome trace\n");
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t numFrames = 100000;
+	RunMode mode = RunMode_Tick;
+	const char* loadFileName = nullptr;
+	const char* saveFileName = nullptr;
+#ifdef ENABLE_TRACING
+	const char* traceFileName = nullptr;
+#endif
+	uint8_t terrainType = 0;
+#ifdef USE_COUNTER_RNG
+	uint32_t randomSeed = DEFAULT_CITY_SEED;
+#endif
+	int fastForwardYears = 0;
+	uint32_t simulationBudget = 0;
+	uint16_t stepsPerFrame = 1;
+#ifdef USE_ZONE_SCHEDULER
+	uint8_t zoneSchedule = ZoneSchedule_Exact;
+#endif
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--frames") && hasValue)
+		{
+			numFrames = (uint32_t)strtoul(argv[++n], nullptr, 10);
+		}
+		else if (!strcmp(argv[n], "--mode") && hasValue)
+		{
+			n++;
+			if (!strcmp(argv[n], "tick"))
+				mode = RunMode_Tick;
+			else if (!strcmp(argv[n], "simulate"))
+				mode = RunMode_Simulate;
+#ifdef USE_MONTH_SIMULATION
+			else if (!strcmp(argv[n], "month"))
+				mode = RunMode_Month;
+#endif
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+#ifdef USE_FAST_FORWARD
+		else if (!strcmp(argv[n], "--fast-forward") && hasValue)
+		{
+			fastForwardYears = atoi(argv[++n]);
+		}
+#endif
+#ifdef USE_SIMULATION_SCHEDULER
+		else if (!strcmp(argv[n], "--budget") && hasValue)
+		{
+			simulationBudget = (uint32_t)strtoul(argv[++n], nullptr, 10);
+		}
+		else if (!strcmp(argv[n], "--steps") && hasValue)
+		{
+			int steps = atoi(argv[++n]);
+			stepsPerFrame = steps > 0 && steps < SIMULATION_STEPS_UNLIMITED ? (uint16_t)steps : SIMULATION_STEPS_UNLIMITED;
+		}
+#endif
+#ifdef USE_ZONE_SCHEDULER
+		else if (!strcmp(argv[n], "--zone-schedule") && hasValue)
+		{
+			n++;
+			if (!strcmp(argv[n], "exact"))
+				zoneSchedule = ZoneSchedule_Exact;
+			else if (!strcmp(argv[n], "settled"))
+				zoneSchedule = ZoneSchedule_Settled;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+#endif
+		else if (!strcmp(argv[n], "--load") && hasValue)
+		{
+			loadFileName = argv[++n];
+		}
+		else if (!strcmp(argv[n], "--save") && hasValue)
+		{
+			saveFileName = argv[++n];
+		}
+#ifdef USE_MONTH_SIMULATION
+		else if (!strcmp(argv[n], "--threads") && hasValue)
+		{
+			SetNumThreads(atoi(argv[++n]));
+		}
+#endif
+		else if (!strcmp(argv[n], "--terrain") && hasValue)
+		{
+			terrainType = (uint8_t)(atoi(argv[++n]) % NUM_TERRAIN_TYPES);
+		}
+#ifdef USE_COUNTER_RNG
+		else if (!strcmp(argv[n], "--seed") && hasValue)
+		{
+			randomSeed = (uint32_t)strtoul(argv[++n], nullptr, 10);
+		}
+#endif
+#ifdef ENABLE_TRACING
+		else if (!strcmp(argv[n], "--trace") && hasValue)
+		{
+			traceFileName = argv[++n];
+		}
+#endif
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	InitGame();
+	SetTerrainType(terrainType);
+#ifdef USE_COUNTER_RNG
+	City.state.randomSeed = randomSeed;
+#endif
+
+	if (loadFileName)
+	{
+		SetSaveFileName(loadFileName);
+		if (!LoadCity())
+		{
+			fprintf(stderr, "Could not load city from %s\n", loadFileName);
+			return 1;
+		}
+	}
+
+	City.uiState.state = InGame;
+	ResetSimulationCaches();
+	ResetVisibleTileCache();
+	SetInputScript(DismissBudgetScript);
+#ifdef USE_SIMULATION_SCHEDULER
+	SetSimulationBudget(simulationBudget, stepsPerFrame);
+#endif
+#ifdef USE_ZONE_SCHEDULER
+	SetZoneSchedule(zoneSchedule);
+#endif
+
+#ifdef ENABLE_TRACING
+	ClearTrace();
+#endif
+
+	auto startTime = std::chrono::steady_clock::now();
+
+#ifdef USE_FAST_FORWARD
+	if (fastForwardYears > 0)
+	{
+		uint16_t targetYear = City.state.year + fastForwardYears;
+		uint8_t targetMonth = City.state.month;
+		int numStops = 0;
+
+		while (FastForward(targetYear, targetMonth, 0) != FastForward_ReachedDate)
+		{
+			City.uiState.state = InGame;
+			numStops++;
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		printf("Fast forwarded %d years in %.3f s, dismissed %d fires and budgets\n", fastForwardYears, seconds, numStops);
+		numFrames = 0;
+	}
+#endif
+
+	double longestFrame = 0;
+
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		if (mode == RunMode_Tick)
+		{
+			auto frameStart = std::chrono::steady_clock::now();
+			TickGame();
+			double frameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+			if (frameTime > longestFrame)
+				longestFrame = frameTime;
+		}
+		else if (mode == RunMode_Simulate)
+		{
+			Simulate();
+		}
+#ifdef USE_MONTH_SIMULATION
+		else
+		{
+			SimulateMonth();
+		}
+#endif
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+	if (numFrames)
+		printf("Ran %u frames in %.3f s: %.0f frames/sec\n", numFrames, seconds, seconds > 0 ? numFrames / seconds : 0.0);
+	if (mode == RunMode_Tick && numFrames)
+		printf("Longest frame: %.3f ms\n", longestFrame * 1000);
+	printf("Date: %s %d, population: %d residential, %d commercial, %d industrial, funds: $%d\n",
+		GetMonthString(City.state.month), City.state.year + 1900,
+		City.state.residentialPopulation, City.state.commercialPopulation, City.state.industrialPopulation, (int)City.state.money);
+
+	if (saveFileName)
+	{
+		SetSaveFileName(saveFileName);
+		SaveCity();
+	}
+
+#ifdef ENABLE_TRACING
+	if (traceFileName && !WriteChromeTrace(traceFileName))
+	{
+		fprintf(stderr, "Could not write trace to %s\n", traceFileName);
+		return 1;
+	}
+#endif
+
+	return 0;
+}
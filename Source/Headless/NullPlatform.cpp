@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Defines.h"
+#include "Game.h"
+#include "City.h"
+#include "Interface.h"
+#include "NullPlatform.h"
+
+#define SAVEGAME_NAME "savedcity.cty"
+
+uint32_t PixelCount = 0;
+
+static uint8_t InputMask = 0;
+static InputScriptFunc InputScript = nullptr;
+static uint32_t InputFrame = 0;
+static const char* SaveFileName = SAVEGAME_NAME;
+
+void ResetPixelCount()
+{
+	PixelCount = 0;
+}
+
+void SetInputMask(uint8_t mask)
+{
+	InputMask = mask;
+}
+
+void SetInputScript(InputScriptFunc script)
+{
+	InputScript = script;
+}
+
+uint32_t GetInputFrame()
+{
+	return InputFrame;
+}
+
+void SetSaveFileName(const char* fileName)
+{
+	SaveFileName = fileName;
+}
+
+const char* GetSaveFileName()
+{
+	return SaveFileName;
+}
+
+uint8_t DismissBudgetScript(uint32_t frame)
+{
+	// Input is edge triggered so the button has to be released between presses
+	if (City.uiState.state == BudgetMenu && City.uiState.selection >= MIN_BUDGET_DISPLAY_TIME && (frame & 1))
+	{
+		return INPUT_A;
+	}
+
+	return 0;
+}
+
+void PutPixel(uint8_t x, uint8_t y, uint8_t colour)
+{
+	PixelCount++;
+}
+
+void DrawBitmap(const uint8_t* bmp, uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	PixelCount += w * h;
+}
+
+uint8_t GetInput()
+{
+	uint8_t result = InputScript ? InputScript(InputFrame) : InputMask;
+	InputFrame++;
+	return result;
+}
+
+uint8_t* GetPowerGrid()
+{
+#ifdef USE_CITY_CONTEXT
+	return City.powerGrid;
+#else
+	// The power grid bitmap is followed by scratch space used as the flood fill stack,
+	// the Arduboy shares the display buffer so allocate the same amount
+	static uint8_t PowerGrid[DISPLAY_WIDTH * DISPLAY_HEIGHT / 8];
+	return PowerGrid;
+#endif
+}
+
+void SaveCity()
+{
+	SaveCityFile(SaveFileName);
+}
+
+bool LoadCity()
+{
+	return LoadCityFile(SaveFileName);
+}
+
+bool SaveCityFile(const char* fileName)
+{
+	FILE* fs = fopen(fileName, "wb");
+
+	if (fs)
+	{
+		bool written = fwrite(&City.state, sizeof(GameState), 1, fs) == 1;
+		fclose(fs);
+		return written;
+	}
+
+	return false;
+}
+
+bool LoadCityFile(const char* fileName)
+{
+	FILE* fs = fopen(fileName, "rb");
+
+	if (fs)
+	{
+		size_t numRead = fread(&City.state, 1, sizeof(GameState), fs);
+		fclose(fs);
+
+#ifdef USE_COUNTER_RNG
+		// Cities from before the random seed was added carry on using the LFSR
+		if (numRead == LEGACY_GAME_STATE_SIZE)
+		{
+			City.state.randomSeed = 0;
+			numRead = sizeof(GameState);
+		}
+#endif
+
+		if (numRead != sizeof(GameState))
+		{
+			return false;
+		}
+
+		if (City.state.timeToNextDisaster > MAX_TIME_BETWEEN_DISASTERS)
+		{
+			City.state.timeToNextDisaster = MIN_TIME_BETWEEN_DISASTERS;
+		}
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Null platform layer for running the game without a display or input device.
+// Provides the functions that MicroCity.ino / WinMain.cpp normally implement:
+// PutPixel, DrawBitmap, GetInput, GetPowerGrid, SaveCity and LoadCity
+
+// Called once per GetInput() with the index of the frame being processed
+typedef uint8_t (*InputScriptFunc)(uint32_t frame);
+
+// Number of PutPixel calls since the last ResetPixelCount
+extern uint32_t PixelCount;
+
+void ResetPixelCount(void);
+
+// Input is either a fixed mask or comes from a script callback if one is set
+void SetInputMask(uint8_t mask);
+void SetInputScript(InputScriptFunc script);
+uint32_t GetInputFrame(void);
+
+// Which file SaveCity / LoadCity read and write
+void SetSaveFileName(const char* fileName);
+const char* GetSaveFileName(void);
+
+// Save or load the current city with a file name of its own, for when several cities are in use
+bool SaveCityFile(const char* fileName);
+bool LoadCityFile(const char* fileName);
+
+// Script that does nothing except close the budget report when it pops up at the end of each year
+uint8_t DismissBudgetScript(uint32_t frame);
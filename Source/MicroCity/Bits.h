@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Number of bits set in a word, adding up neighbouring bits then pairs then nibbles
+inline int CountSetBits(uint32_t word)
+{
+	word = word - ((word >> 1) & 0x55555555u);
+	word = (word & 0x33333333u) + ((word >> 2) & 0x33333333u);
+	word = (word + (word >> 4)) & 0x0F0F0F0Fu;
+	return (int)((word * 0x01010101u) >> 24);
+}
+
+// Index of the lowest set bit, word mustn't be 0
+inline int LowestSetBit(uint32_t word)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctz(word);
+#endif
+}
@@ -1,7 +1,10 @@
 #include "Game.h"
+#include "City.h"
 #include "Building.h"
 #include "Connectivity.h"
 #include "Draw.h"
+#include "BuildingIndex.h"
+#include "Simulation.h"
 
 const BuildingInfo BuildingMetaData[] PROGMEM =
 {
@@ -40,7 +43,7 @@ bool PlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 
 	while (index < MAX_BUILDINGS)
 	{
-		if (State.buildings[index].type == 0)
+		if (City.state.buildings[index].type == 0)
 		{
 			break;
 		}
@@ -54,7 +57,7 @@ bool PlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 
 		while (index < MAX_BUILDINGS)
 		{
-			if (State.buildings[index].type == Rubble3x3 || State.buildings[index].type == Rubble4x4)
+			if (City.state.buildings[index].type == Rubble3x3 || City.state.buildings[index].type == Rubble4x4)
 			{
 				break;
 			}
@@ -67,7 +70,7 @@ bool PlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 		}
 	}
 
-	Building* newBuilding = &State.buildings[index];
+	Building* newBuilding = &City.state.buildings[index];
 	newBuilding->type = buildingType;
 	newBuilding->x = x;
 	newBuilding->y = y;
@@ -92,7 +95,7 @@ bool PlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 	// Check for overlapping rubble and remove
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (IsRubble(building->type))
 		{
@@ -104,10 +107,15 @@ bool PlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 				&& y + height > building->y && y < building->y + otherHeight)
 			{
 				building->type = 0;
+				building->onFire = 0;
+				UpdateBuildingCaches(building);
 			}
 		}
 	}
 
+	RebuildBuildingIndex();
+	InvalidateRoadConnections(newBuilding);
+	UpdateBuildingCaches(newBuilding);
 	RefreshBuildingTiles(newBuilding);
 
 	return true;
@@ -141,7 +149,7 @@ bool CanPlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 	// Check building overlaps
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (building->type && !IsRubble(building->type))
 		{
@@ -163,9 +171,12 @@ bool CanPlaceBuilding(uint8_t buildingType, uint8_t x, uint8_t y)
 
 Building* GetBuilding(uint8_t x, uint8_t y)
 {
+#ifdef USE_BUILDING_INDEX
+	return GetIndexedBuildingAt(x, y);
+#else
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (building->type)
 		{
@@ -181,6 +192,7 @@ Building* GetBuilding(uint8_t x, uint8_t y)
 	}
 
 	return nullptr;
+#endif
 }
 
 void DestroyBuilding(Building* building)
@@ -197,8 +209,11 @@ void DestroyBuilding(Building* building)
 		}
 	}
 
+	AddZonePopulation(building, -building->populationDensity);
 	building->onFire = 0;
 	building->type = width == 3 ? Rubble3x3 : Rubble4x4;
+	InvalidateRoadConnections(building);
+	UpdateBuildingCaches(building);
 
 	for (uint8_t y = building->y; y < building->y + height; y++)
 	{
@@ -23,6 +23,14 @@ inline bool IsRubble(uint8_t buildingType)
 	return buildingType >= Rubble3x3;
 }
 
+inline uint16_t BuildingTypeMask(uint8_t buildingType)
+{
+	return (uint16_t)1 << buildingType;
+}
+
+// Every type apart from none
+#define ALL_BUILDING_TYPES_MASK ((1 << (Rubble4x4 + 1)) - 2)
+
 typedef struct
 {
 	uint8_t x : 6;
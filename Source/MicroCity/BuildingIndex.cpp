@@ -0,0 +1,219 @@
+#include "BuildingIndex.h"
+#include "Simulation.h"
+
+#ifdef USE_BUILDING_INDEX
+
+#ifdef ENABLE_CHECKS
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#define NOT_INDEXED 0xff
+
+// Buildings only move when they are placed so the whole index is rebuilt then, which is cheap next to
+// the queries. Slots cleared since the last rebuild are skipped by the queries' type check
+
+static uint8_t GetIndexedBuildingFlags(Building* building)
+{
+	return (building->onFire ? IndexedBuilding_OnFire : 0)
+		| (building->heavyTraffic ? IndexedBuilding_HeavyTraffic : 0)
+		| (building->hasPower ? IndexedBuilding_HasPower : 0)
+		| (IsRoadConnected(building) ? IndexedBuilding_RoadConnected : 0);
+}
+
+static uint8_t GetBuildingIndexCell(Building* building)
+{
+	return (building->y >> BUILDING_INDEX_CELL_SHIFT) * BUILDING_INDEX_CELLS_X + (building->x >> BUILDING_INDEX_CELL_SHIFT);
+}
+
+static void AddToBuildingTypeTotals(BuildingTypeTotals* totals, uint8_t type, uint8_t flags, int sign)
+{
+	if (type)
+	{
+		totals[type].count += sign;
+		totals[type].powered += (flags & IndexedBuilding_HasPower) ? sign : 0;
+		totals[type].heavyTraffic += (flags & IndexedBuilding_HeavyTraffic) ? sign : 0;
+		totals[type].onFire += (flags & IndexedBuilding_OnFire) ? sign : 0;
+	}
+}
+
+void RebuildBuildingIndex()
+{
+	uint8_t cellCount[BUILDING_INDEX_NUM_CELLS] = { 0 };
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.state.buildings[n].type)
+		{
+			cellCount[GetBuildingIndexCell(&City.state.buildings[n])]++;
+		}
+	}
+
+	uint8_t start = 0;
+	for (int cell = 0; cell < BUILDING_INDEX_NUM_CELLS; cell++)
+	{
+		City.buildingIndexCellStart[cell] = start;
+		start += cellCount[cell];
+	}
+	City.buildingIndexCellStart[BUILDING_INDEX_NUM_CELLS] = start;
+
+	City.indexedBuildings.count = start;
+	memset(City.buildingIndexEntryOfSlot, NOT_INDEXED, sizeof(City.buildingIndexEntryOfSlot));
+
+	// Fill each cell from the back so the slots stay in order within a cell
+	for (int n = MAX_BUILDINGS - 1; n >= 0; n--)
+	{
+		if (City.state.buildings[n].type)
+		{
+			uint8_t cell = GetBuildingIndexCell(&City.state.buildings[n]);
+			uint8_t entry = City.buildingIndexCellStart[cell] + --cellCount[cell];
+
+			City.indexedBuildings.slot[entry] = n;
+			City.buildingIndexEntryOfSlot[n] = entry;
+			UpdateIndexedBuilding(&City.state.buildings[n]);
+		}
+	}
+
+	// The entries were reused, so what UpdateIndexedBuilding took off the totals was meaningless
+	AddUpBuildingTypeTotals(City.buildingTypeTotals);
+	City.buildingTileMapDirty = true;
+}
+
+void UpdateIndexedBuilding(Building* building)
+{
+	uint8_t entry = City.buildingIndexEntryOfSlot[building - City.state.buildings];
+
+	// Slots are only filled by PlaceBuilding, which rebuilds the index
+	if (entry == NOT_INDEXED)
+		return;
+
+	uint8_t flags = GetIndexedBuildingFlags(building);
+
+	if (City.indexedBuildings.type[entry] != building->type)
+		City.buildingTileMapDirty = true;
+
+	AddToBuildingTypeTotals(City.buildingTypeTotals, City.indexedBuildings.type[entry], City.indexedBuildings.flags[entry], -1);
+	AddToBuildingTypeTotals(City.buildingTypeTotals, building->type, flags, 1);
+
+	City.indexedBuildings.x[entry] = building->x;
+	City.indexedBuildings.y[entry] = building->y;
+	City.indexedBuildings.type[entry] = building->type;
+	City.indexedBuildings.populationDensity[entry] = building->populationDensity;
+	City.indexedBuildings.flags[entry] = flags;
+}
+
+void AddUpBuildingTypeTotals(BuildingTypeTotals* totals)
+{
+	memset(totals, 0, sizeof(BuildingTypeTotals) * NUM_BUILDING_TYPE_TOTALS);
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+		AddToBuildingTypeTotals(totals, building->type, GetIndexedBuildingFlags(building), 1);
+	}
+}
+
+// Buildings only change size when they turn into rubble or are cleared, which is rare enough to fill the
+// whole map in again. It is filled from the last slot so the first one wins anywhere buildings overlap,
+// the same as going through the buildings in order
+static void FillBuildingTileMap(uint8_t* map)
+{
+	memset(map, 0, MAP_WIDTH * MAP_HEIGHT);
+
+	for (int n = MAX_BUILDINGS - 1; n >= 0; n--)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type)
+		{
+			const BuildingInfo* info = GetBuildingInfo(building->type);
+			int x2 = building->x + pgm_read_byte(&info->width);
+			int y2 = building->y + pgm_read_byte(&info->height);
+
+			for (int y = building->y; y < y2 && y < MAP_HEIGHT; y++)
+			{
+				for (int x = building->x; x < x2 && x < MAP_WIDTH; x++)
+				{
+					map[y * MAP_WIDTH + x] = n + 1;
+				}
+			}
+		}
+	}
+}
+
+Building* GetIndexedBuildingAt(uint8_t x, uint8_t y)
+{
+	if (x >= MAP_WIDTH || y >= MAP_HEIGHT)
+		return nullptr;
+
+	if (City.buildingTileMapDirty)
+	{
+		FillBuildingTileMap(City.buildingTileMap);
+		City.buildingTileMapDirty = false;
+	}
+
+	uint8_t slot = City.buildingTileMap[y * MAP_WIDTH + x];
+	return slot ? &City.state.buildings[slot - 1] : nullptr;
+}
+
+#ifdef ENABLE_CHECKS
+void CheckBuildingTileMap()
+{
+	// A building that changed type without the map being marked would leave it out of date
+	if (City.buildingTileMapDirty)
+		return;
+
+	uint8_t map[MAP_WIDTH * MAP_HEIGHT];
+	FillBuildingTileMap(map);
+
+	if (memcmp(map, City.buildingTileMap, sizeof(map)))
+	{
+		fprintf(stderr, "Building tile map doesn't match the buildings\n");
+		abort();
+	}
+}
+#endif
+
+bool NextBuildingSpan(BuildingQuery* query, uint8_t* start, uint8_t* end)
+{
+	while (query->cellY <= query->maxCellY)
+	{
+		uint8_t rowCell = query->cellY * BUILDING_INDEX_CELLS_X;
+
+		*start = City.buildingIndexCellStart[rowCell + query->minCellX];
+		*end = City.buildingIndexCellStart[rowCell + query->maxCellX + 1];
+		query->cellY++;
+
+		if (*start < *end)
+			return true;
+	}
+
+	return false;
+}
+
+#else
+
+void RebuildBuildingIndex()
+{
+}
+
+#endif
+
+void BeginBuildingQuery(BuildingQuery* query, uint8_t x, uint8_t y, uint8_t radius, uint16_t typeMask)
+{
+	query->x = x;
+	query->y = y;
+	query->radius = radius;
+	query->typeMask = typeMask;
+	query->distance = 0;
+	query->next = 0;
+
+#ifdef USE_BUILDING_INDEX
+	query->end = 0;
+	query->minCellX = x > radius ? (x - radius) >> BUILDING_INDEX_CELL_SHIFT : 0;
+	query->maxCellX = x + radius < MAP_WIDTH ? (x + radius) >> BUILDING_INDEX_CELL_SHIFT : BUILDING_INDEX_CELLS_X - 1;
+	query->cellY = y > radius ? (y - radius) >> BUILDING_INDEX_CELL_SHIFT : 0;
+	query->maxCellY = y + radius < MAP_HEIGHT ? (y + radius) >> BUILDING_INDEX_CELL_SHIFT : BUILDING_INDEX_CELLS_Y - 1;
+	query->cellX = query->minCellX;
+#endif
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "City.h"
+
+// Finds the buildings of the types in typeMask whose top left corner is within a Manhattan distance
+// of radius from (x, y), for the simulation's neighbourhood checks. On desktop builds the buildings are
+// bucketed into cells so a query only walks the cells near it, on the Arduboy it scans City.state.buildings.
+// Buildings must not be placed while a query is in use
+
+#ifdef USE_BUILDING_INDEX
+enum IndexedBuildingFlags
+{
+	IndexedBuilding_OnFire = 1,
+	IndexedBuilding_HeavyTraffic = 2,
+	IndexedBuilding_HasPower = 4,
+	IndexedBuilding_RoadConnected = 8
+};
+#endif
+
+typedef struct
+{
+	uint8_t x;
+	uint8_t y;
+	uint8_t radius;
+	uint8_t distance;	// Distance to the last building returned
+	uint16_t typeMask;
+	uint8_t next;
+#ifdef USE_BUILDING_INDEX
+	uint8_t end;
+	uint8_t cellX, cellY;
+	uint8_t minCellX, maxCellX, maxCellY;
+#endif
+} BuildingQuery;
+
+// Must be called after any building is placed or City.state.buildings is replaced
+void RebuildBuildingIndex(void);
+
+#ifdef USE_BUILDING_INDEX
+void UpdateIndexedBuilding(Building* building);
+
+// How many buildings of a type there are, and how many of those have power, heavy traffic or are on fire.
+// Kept up to date by UpdateIndexedBuilding
+inline const BuildingTypeTotals* GetBuildingTypeTotals(uint8_t buildingType)
+{
+	return &City.buildingTypeTotals[buildingType];
+}
+
+// Adds the totals up from scratch, for checking the running ones
+void AddUpBuildingTypeTotals(BuildingTypeTotals* totals);
+
+// GetBuilding looks the tile up in City.buildingTileMap, which is filled in again the first time it is
+// needed after a building changes type. Must not be called from the workers
+Building* GetIndexedBuildingAt(uint8_t x, uint8_t y);
+
+#ifdef ENABLE_CHECKS
+// Aborts if the tile map doesn't match the buildings
+void CheckBuildingTileMap(void);
+#endif
+
+// Instead of NextBuilding, walks the entries in City.indexedBuildings one row of cells at a time. The
+// entries between start and end still need checking against the radius and type mask
+bool NextBuildingSpan(BuildingQuery* query, uint8_t* start, uint8_t* end);
+#else
+inline void UpdateIndexedBuilding(Building* building) {}
+#endif
+
+void BeginBuildingQuery(BuildingQuery* query, uint8_t x, uint8_t y, uint8_t radius, uint16_t typeMask);
+#ifdef USE_BUILDING_INDEX
+// Moves the query on to the next cell with some part inside the radius, returns false when there are none left
+inline bool NextBuildingIndexCell(BuildingQuery* query)
+{
+	while (query->cellY <= query->maxCellY)
+	{
+		uint8_t cellX1 = query->cellX << BUILDING_INDEX_CELL_SHIFT;
+		uint8_t cellY1 = query->cellY << BUILDING_INDEX_CELL_SHIFT;
+		uint8_t cellX2 = cellX1 + BUILDING_INDEX_CELL_SIZE - 1;
+		uint8_t cellY2 = cellY1 + BUILDING_INDEX_CELL_SIZE - 1;
+		uint8_t dx = query->x < cellX1 ? cellX1 - query->x : query->x > cellX2 ? query->x - cellX2 : 0;
+		uint8_t dy = query->y < cellY1 ? cellY1 - query->y : query->y > cellY2 ? query->y - cellY2 : 0;
+		uint8_t cell = query->cellY * BUILDING_INDEX_CELLS_X + query->cellX;
+
+		if (query->cellX == query->maxCellX)
+		{
+			query->cellX = query->minCellX;
+			query->cellY++;
+		}
+		else query->cellX++;
+
+		if (dx + dy <= query->radius)
+		{
+			query->next = City.buildingIndexCellStart[cell];
+			query->end = City.buildingIndexCellStart[cell + 1];
+			return true;
+		}
+	}
+
+	return false;
+}
+#endif
+
+inline bool MatchesBuildingQuery(BuildingQuery* query, Building* building)
+{
+	if (!(query->typeMask & BuildingTypeMask(building->type)))
+		return false;
+
+	uint8_t dx = query->x > building->x ? query->x - building->x : building->x - query->x;
+	uint8_t dy = query->y > building->y ? query->y - building->y : building->y - query->y;
+
+	if (dx + dy > query->radius)
+		return false;
+
+	query->distance = dx + dy;
+	return true;
+}
+
+// Returns nullptr once there are no more matching buildings
+inline Building* NextBuilding(BuildingQuery* query)
+{
+#ifdef USE_BUILDING_INDEX
+	do
+	{
+		while (query->next < query->end)
+		{
+			Building* building = &City.state.buildings[City.indexedBuildings.slot[query->next++]];
+
+			if (MatchesBuildingQuery(query, building))
+				return building;
+		}
+	} while (NextBuildingIndexCell(query));
+#else
+	while (query->next < MAX_BUILDINGS)
+	{
+		Building* building = &City.state.buildings[query->next++];
+
+		if (MatchesBuildingQuery(query, building))
+			return building;
+	}
+#endif
+
+	return nullptr;
+}
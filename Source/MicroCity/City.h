@@ -0,0 +1,199 @@
+#pragma once
+
+#include "Defines.h"
+#include "Game.h"
+#include "Interface.h"
+
+// Everything that belongs to one city: the saved GameState, the interface and everything derived from
+// them. The Arduboy has a single static instance. Desktop builds can have any number, each thread works
+// on the one set with SetCurrentCity so several cities can be simulated at the same time
+
+#ifdef USE_BUILDING_INDEX
+#define BUILDING_INDEX_CELL_SIZE (1 << BUILDING_INDEX_CELL_SHIFT)
+#define BUILDING_INDEX_CELLS_X ((MAP_WIDTH + BUILDING_INDEX_CELL_SIZE - 1) >> BUILDING_INDEX_CELL_SHIFT)
+#define BUILDING_INDEX_CELLS_Y ((MAP_HEIGHT + BUILDING_INDEX_CELL_SIZE - 1) >> BUILDING_INDEX_CELL_SHIFT)
+#define BUILDING_INDEX_NUM_CELLS (BUILDING_INDEX_CELLS_X * BUILDING_INDEX_CELLS_Y)
+
+// The index keeps its own copy of the buildings as separate arrays, sorted by cell so that a row of
+// cells is one contiguous run which loops can walk without unpacking the Building bitfields.
+// City.state.buildings is still the master copy and UpdateIndexedBuilding copies a building's fields across.
+// The arrays are padded so the vector kernels can read a whole register past the last entry
+#define INDEXED_BUILDING_PADDING 32
+#define INDEXED_BUILDING_ARRAY_SIZE (MAX_BUILDINGS + INDEXED_BUILDING_PADDING)
+
+typedef struct
+{
+	uint8_t count;
+	uint8_t slot[INDEXED_BUILDING_ARRAY_SIZE];		// Index into City.state.buildings
+	uint8_t x[INDEXED_BUILDING_ARRAY_SIZE];
+	uint8_t y[INDEXED_BUILDING_ARRAY_SIZE];
+	uint8_t type[INDEXED_BUILDING_ARRAY_SIZE];
+	uint8_t populationDensity[INDEXED_BUILDING_ARRAY_SIZE];
+	uint8_t flags[INDEXED_BUILDING_ARRAY_SIZE];
+} IndexedBuildingArrays;
+
+// Running totals for each building type, including rubble
+#define NUM_BUILDING_TYPE_TOTALS (Rubble4x4 + 1)
+
+typedef struct
+{
+	uint8_t count;
+	uint8_t powered;
+	uint8_t heavyTraffic;
+	uint8_t onFire;
+} BuildingTypeTotals;
+#endif
+
+#ifdef USE_FIRE_TRACKING
+// A bit for each building slot
+#define BUILDING_SET_WORDS ((MAX_BUILDINGS + 31) / 32)
+#endif
+
+#ifdef USE_POLLUTION_FIELD
+typedef struct
+{
+	uint8_t x;
+	uint8_t y;
+	uint8_t strength;
+} PollutionStamp;
+#endif
+
+typedef struct CityContext
+{
+	GameState state;
+	UIStateStruct uiState;
+
+	// For repeating held buttons
+	uint8_t lastInput;
+	uint8_t inputRepeatCounter;
+
+	// GetRand's LFSR, zero until the first number is drawn
+	uint16_t randVal;
+#ifdef USE_COUNTER_RNG
+	bool legacyRandom;
+	uint32_t nextCitySeed;		// 0 until set or first used
+#endif
+
+	// Currently visible tiles are cached so they don't need to be recalculated between frames
+	uint8_t visibleTileCache[VISIBLE_TILES_X * VISIBLE_TILES_Y];
+	int8_t cachedScrollX, cachedScrollY;
+	uint8_t animationFrame;
+#ifdef USE_FAST_FORWARD
+	bool tileCacheSuspended;
+#endif
+
+#ifdef USE_CITY_CONTEXT
+	// The Arduboy shares the display buffer, which is also used as the flood fill stack
+	uint8_t powerGrid[DISPLAY_WIDTH * DISPLAY_HEIGHT / 8];
+#endif
+
+#ifdef USE_SIMULATION_SCHEDULER
+	uint32_t simulationBudget;				// Microseconds per frame, 0 for one step per tick
+	uint16_t simulationStepsPerFrame;
+	uint16_t simulationStepsOwed;			// Steps which didn't fit in earlier frames
+
+	// The power flood fill UpdatePowerConnectivity is part way through
+	uint8_t powerFillState;
+	uint8_t powerFillNextSlot;				// Where to carry on looking for power plants
+	uint16_t powerFillStackSize;
+#endif
+
+#ifdef USE_ZONE_SCHEDULER
+	uint8_t zoneSchedule;
+	uint8_t zoneSettledMonths[MAX_BUILDINGS];		// Months a settled zone can go before it is scored again
+	uint8_t zoneScheduleKinds[MAX_BUILDINGS];		// Each slot's type, power and fire when last seen
+	uint8_t zoneScheduleDensities[MAX_BUILDINGS];
+	uint8_t zoneScheduleTaxRate;					// What every zone was last scored with
+	uint8_t zoneSchedulePopulationEffects;
+#endif
+
+#ifdef USE_BUILDING_INDEX
+	IndexedBuildingArrays indexedBuildings;
+	uint8_t buildingIndexCellStart[BUILDING_INDEX_NUM_CELLS + 1];	// The entries for a cell start here
+	uint8_t buildingIndexEntryOfSlot[MAX_BUILDINGS];
+	BuildingTypeTotals buildingTypeTotals[NUM_BUILDING_TYPE_TOTALS];	// Added up from the index's entries
+	uint8_t buildingTileMap[MAP_WIDTH * MAP_HEIGHT];	// Slot + 1 of the building covering each tile, 0 for none
+	bool buildingTileMapDirty;
+#endif
+
+#ifdef USE_FIRE_TRACKING
+	uint32_t burningBuildings[BUILDING_SET_WORDS];
+	uint32_t flammableBuildings[BUILDING_SET_WORDS];	// The ones StartRandomFire can pick from
+#endif
+
+#ifdef USE_TRAFFIC_FLOW
+	uint16_t trafficQueue[MAP_WIDTH * MAP_HEIGHT];		// Road tiles in the order the search reached them
+	uint16_t trafficNextTile[MAP_WIDTH * MAP_HEIGHT];	// One tile closer to a job along the roads
+	uint16_t trafficDistance[MAP_WIDTH * MAP_HEIGHT];
+	uint16_t trafficLoad[MAP_WIDTH * MAP_HEIGHT];		// Being added up by the pass in progress
+	uint8_t roadTraffic[MAP_WIDTH * MAP_HEIGHT];		// From the last finished pass
+	uint8_t trafficZones[MAX_BUILDINGS];				// What each building slot was counted as
+	uint16_t trafficQueueHead, trafficQueueTail;
+	uint16_t trafficAddIndex;
+	uint8_t trafficPassState;
+	bool trafficRoutesDirty;
+	bool trafficLoadsDirty;
+#endif
+
+#ifdef USE_POLLUTION_FIELD
+	int16_t pollutionField[MAP_WIDTH * MAP_HEIGHT];
+	PollutionStamp pollutionStamps[MAX_BUILDINGS];		// What each building slot has currently added to the field
+#endif
+
+#ifdef USE_LAND_VALUE
+	int16_t landValue[MAP_WIDTH * MAP_HEIGHT];
+#endif
+
+#ifdef USE_COVERAGE_MAPS
+	uint8_t policeDistanceMap[MAP_WIDTH * MAP_HEIGHT];
+	uint8_t fireDeptDistanceMap[MAP_WIDTH * MAP_HEIGHT];
+	uint8_t coverageSources[MAX_BUILDINGS];		// Which building slots the maps were last built from
+	bool coverageDirty;
+#endif
+
+#ifdef USE_ROAD_CONNECTION_CACHE
+	uint8_t roadConnectionCounts[MAX_BUILDINGS];	// Number of road tiles around each building slot
+	uint16_t numRoadTiles;							// Kept up to date by SetConnections
+#endif
+
+#ifdef USE_MONTH_SIMULATION
+	uint8_t monthZoneSlots[MAX_BUILDINGS];
+	int8_t monthRandomEffects[MAX_BUILDINGS];
+	int8_t monthDensityChanges[MAX_BUILDINGS];
+	bool monthDensityChangeScored[MAX_BUILDINGS];
+#endif
+} CityContext;
+
+#ifdef USE_CITY_CONTEXT
+// thread_local would check for a dynamic initialiser on every access from other files
+#ifdef _MSC_VER
+#define CITY_THREAD_LOCAL __declspec(thread)
+#else
+#define CITY_THREAD_LOCAL __thread
+#endif
+
+extern CITY_THREAD_LOCAL CityContext* CurrentCity;
+#define City (*CurrentCity)
+
+// Each thread starts on the main city
+CityContext* GetMainCity(void);
+inline void SetCurrentCity(CityContext* city) { CurrentCity = city; }
+
+// Makes a city current until the end of the scope, then goes back to the one before
+class CurrentCityScope
+{
+public:
+	CurrentCityScope(CityContext* city) : previousCity(CurrentCity) { CurrentCity = city; }
+	~CurrentCityScope() { CurrentCity = previousCity; }
+
+private:
+	CityContext* previousCity;
+};
+
+// A new city with InitGame already called on it, with randomSeed (0 for the LFSR) unless counter based random
+// numbers are turned off. Replace its state and call ResetSimulationCaches to run a saved city instead
+CityContext* CreateCity(uint32_t randomSeed);
+void DestroyCity(CityContext* city);
+#else
+extern CityContext City;
+#endif
@@ -0,0 +1,429 @@
+#include "CitySnapshot.h"
+#include "Draw.h"
+#include "Simulation.h"
+#include "Trace.h"
+
+#ifdef USE_CITY_SNAPSHOTS
+
+#ifndef USE_CITY_CONTEXT
+#error City snapshots rely on having more than one city
+#endif
+
+#include <atomic>
+#include <string.h>
+
+struct CitySnapshotBlock
+{
+	std::atomic<uint32_t> refCount;
+	uint8_t data[CITY_SNAPSHOT_BLOCK_SIZE];
+};
+
+// What the simulation has part way done or carries on from month to month, which can't be worked out again
+// from GameState. Snapshots keep it in blocks as well so a restored city carries on exactly as it would have
+typedef struct
+{
+	size_t offset;
+	size_t size;
+} CitySnapshotRegion;
+
+#define CITY_SNAPSHOT_REGION(field) { offsetof(CityContext, field), sizeof(((CityContext*)0)->field) }
+
+static constexpr CitySnapshotRegion progressRegions[] =
+{
+	CITY_SNAPSHOT_REGION(powerGrid),
+#ifdef USE_SIMULATION_SCHEDULER
+	CITY_SNAPSHOT_REGION(simulationStepsOwed),
+	CITY_SNAPSHOT_REGION(powerFillState),
+	CITY_SNAPSHOT_REGION(powerFillNextSlot),
+	CITY_SNAPSHOT_REGION(powerFillStackSize),
+#endif
+#ifdef USE_ZONE_SCHEDULER
+	CITY_SNAPSHOT_REGION(zoneSettledMonths),
+	CITY_SNAPSHOT_REGION(zoneScheduleKinds),
+	CITY_SNAPSHOT_REGION(zoneScheduleDensities),
+	CITY_SNAPSHOT_REGION(zoneScheduleTaxRate),
+	CITY_SNAPSHOT_REGION(zoneSchedulePopulationEffects),
+#endif
+#ifdef USE_TRAFFIC_FLOW
+	CITY_SNAPSHOT_REGION(trafficQueue),
+	CITY_SNAPSHOT_REGION(trafficNextTile),
+	CITY_SNAPSHOT_REGION(trafficDistance),
+	CITY_SNAPSHOT_REGION(trafficLoad),
+	CITY_SNAPSHOT_REGION(roadTraffic),
+	CITY_SNAPSHOT_REGION(trafficZones),
+	CITY_SNAPSHOT_REGION(trafficQueueHead),
+	CITY_SNAPSHOT_REGION(trafficQueueTail),
+	CITY_SNAPSHOT_REGION(trafficAddIndex),
+	CITY_SNAPSHOT_REGION(trafficPassState),
+	CITY_SNAPSHOT_REGION(trafficRoutesDirty),
+	CITY_SNAPSHOT_REGION(trafficLoadsDirty),
+#endif
+#ifdef USE_LAND_VALUE
+	CITY_SNAPSHOT_REGION(landValue),
+#endif
+};
+
+#define NUM_PROGRESS_REGIONS (sizeof(progressRegions) / sizeof(progressRegions[0]))
+
+static constexpr size_t CountProgressBlocks(size_t numRegions)
+{
+	return numRegions ? CountProgressBlocks(numRegions - 1)
+		+ (progressRegions[numRegions - 1].size + CITY_SNAPSHOT_BLOCK_SIZE - 1) / CITY_SNAPSHOT_BLOCK_SIZE : 0;
+}
+
+#define NUM_PROGRESS_BLOCKS CountProgressBlocks(NUM_PROGRESS_REGIONS)
+
+struct CitySnapshot
+{
+	CitySnapshotBlock* blocks[CITY_SNAPSHOT_NUM_BLOCKS];
+	CitySnapshotBlock* progressBlocks[NUM_PROGRESS_BLOCKS];
+
+	// Not part of GameState but the simulation depends on them
+	uint16_t randVal;
+#ifdef USE_COUNTER_RNG
+	bool legacyRandom;
+#endif
+};
+
+static inline size_t GetBlockSize(size_t block)
+{
+	size_t offset = block * CITY_SNAPSHOT_BLOCK_SIZE;
+	return sizeof(GameState) - offset < CITY_SNAPSHOT_BLOCK_SIZE ? sizeof(GameState) - offset : CITY_SNAPSHOT_BLOCK_SIZE;
+}
+
+// Where a block of the work in progress lives in a city, returning how much of it is used
+static size_t GetProgressBlock(CityContext* city, size_t block, uint8_t** data)
+{
+	for (size_t n = 0; n < NUM_PROGRESS_REGIONS; n++)
+	{
+		size_t numBlocks = (progressRegions[n].size + CITY_SNAPSHOT_BLOCK_SIZE - 1) / CITY_SNAPSHOT_BLOCK_SIZE;
+
+		if (block < numBlocks)
+		{
+			size_t offset = block * CITY_SNAPSHOT_BLOCK_SIZE;
+			*data = (uint8_t*)city + progressRegions[n].offset + offset;
+			return progressRegions[n].size - offset < CITY_SNAPSHOT_BLOCK_SIZE ? progressRegions[n].size - offset : CITY_SNAPSHOT_BLOCK_SIZE;
+		}
+		block -= numBlocks;
+	}
+	return 0;
+}
+
+size_t GetCitySnapshotProgressBlocks()
+{
+	return NUM_PROGRESS_BLOCKS;
+}
+
+static inline CitySnapshotBlock* ShareBlock(CitySnapshotBlock* block)
+{
+	block->refCount.fetch_add(1, std::memory_order_relaxed);
+	return block;
+}
+
+static inline void ReleaseBlock(CitySnapshotBlock* block)
+{
+	if (block->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete block;
+	}
+}
+
+// Shares the base's block if it holds the same data
+static CitySnapshotBlock* TakeBlock(const uint8_t* data, size_t size, CitySnapshotBlock* base)
+{
+	if (base && !memcmp(base->data, data, size))
+		return ShareBlock(base);
+
+	CitySnapshotBlock* block = new CitySnapshotBlock;
+	block->refCount.store(1, std::memory_order_relaxed);
+	memset(block->data, 0, sizeof(block->data));
+	memcpy(block->data, data, size);
+	return block;
+}
+
+CitySnapshot* TakeCitySnapshot(CityContext* city, const CitySnapshot* base)
+{
+	TRACE_ZONE("TakeCitySnapshot");
+	CitySnapshot* snapshot = new CitySnapshot;
+	const uint8_t* state = (const uint8_t*)&city->state;
+
+	for (size_t n = 0; n < CITY_SNAPSHOT_NUM_BLOCKS; n++)
+	{
+		snapshot->blocks[n] = TakeBlock(state + n * CITY_SNAPSHOT_BLOCK_SIZE, GetBlockSize(n), base ? base->blocks[n] : nullptr);
+	}
+
+	for (size_t n = 0; n < NUM_PROGRESS_BLOCKS; n++)
+	{
+		uint8_t* data;
+		size_t size = GetProgressBlock(city, n, &data);
+		snapshot->progressBlocks[n] = TakeBlock(data, size, base ? base->progressBlocks[n] : nullptr);
+	}
+
+	snapshot->randVal = city->randVal;
+#ifdef USE_COUNTER_RNG
+	snapshot->legacyRandom = city->legacyRandom;
+#endif
+
+	return snapshot;
+}
+
+CitySnapshot* ForkCitySnapshot(const CitySnapshot* snapshot)
+{
+	CitySnapshot* fork = new CitySnapshot(*snapshot);
+
+	for (size_t n = 0; n < CITY_SNAPSHOT_NUM_BLOCKS; n++)
+	{
+		ShareBlock(fork->blocks[n]);
+	}
+	for (size_t n = 0; n < NUM_PROGRESS_BLOCKS; n++)
+	{
+		ShareBlock(fork->progressBlocks[n]);
+	}
+
+	return fork;
+}
+
+void DiscardCitySnapshot(CitySnapshot* snapshot)
+{
+	if (!snapshot)
+		return;
+
+	for (size_t n = 0; n < CITY_SNAPSHOT_NUM_BLOCKS; n++)
+	{
+		ReleaseBlock(snapshot->blocks[n]);
+	}
+	for (size_t n = 0; n < NUM_PROGRESS_BLOCKS; n++)
+	{
+		ReleaseBlock(snapshot->progressBlocks[n]);
+	}
+
+	delete snapshot;
+}
+
+// Works out which part of GameState a byte belongs to
+static void MarkChangedByte(CitySnapshotDiff* diff, size_t offset)
+{
+	const size_t connectionMapStart = offsetof(GameState, connectionMap);
+	const size_t buildingsStart = offsetof(GameState, buildings);
+
+	if (offset >= connectionMapStart && offset < connectionMapStart + sizeof(((GameState*)0)->connectionMap))
+	{
+		int row = (int)((offset - connectionMapStart) * 4 / MAP_WIDTH);
+		diff->changedRows[row >> 3] |= 1 << (row & 7);
+	}
+	else if (offset >= buildingsStart && offset < buildingsStart + sizeof(((GameState*)0)->buildings))
+	{
+		int slot = (int)((offset - buildingsStart) / sizeof(Building));
+		diff->changedBuildings[slot >> 5] |= 1u << (slot & 31);
+	}
+	else
+	{
+		diff->otherStateChanged = true;
+	}
+}
+
+// Returns false if a block is the same, otherwise marks which parts of it aren't
+static bool DiffBlock(const uint8_t* dataA, const uint8_t* dataB, size_t block, CitySnapshotDiff* diff)
+{
+	size_t size = GetBlockSize(block);
+
+	if (!memcmp(dataA, dataB, size))
+		return false;
+
+	diff->numChangedBlocks++;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (dataA[i] != dataB[i])
+		{
+			MarkChangedByte(diff, block * CITY_SNAPSHOT_BLOCK_SIZE + i);
+		}
+	}
+	return true;
+}
+
+static inline bool IsRowChanged(const CitySnapshotDiff* diff, int row)
+{
+	return (diff->changedRows[row >> 3] >> (row & 7)) & 1;
+}
+
+static inline bool IsBuildingChanged(const CitySnapshotDiff* diff, int slot)
+{
+	return (diff->changedBuildings[slot >> 5] >> (slot & 31)) & 1;
+}
+
+static bool AnyChanged(const uint8_t* bits, size_t size)
+{
+	for (size_t n = 0; n < size; n++)
+	{
+		if (bits[n])
+			return true;
+	}
+	return false;
+}
+
+static void RefreshTiles(int x1, int y1, int x2, int y2)
+{
+	for (int y = y1 < 0 ? 0 : y1; y <= y2 && y < MAP_HEIGHT; y++)
+	{
+		for (int x = x1 < 0 ? 0 : x1; x <= x2 && x < MAP_WIDTH; x++)
+		{
+			RefreshTile(x, y);
+		}
+	}
+}
+
+// The tiles a building covers and the roads around it, which show its traffic
+static void RefreshBuildingSurroundings(const Building* building)
+{
+	if (!building->type)
+		return;
+
+	const BuildingInfo* info = GetBuildingInfo(building->type);
+	uint8_t width = pgm_read_byte(&info->width);
+	uint8_t height = pgm_read_byte(&info->height);
+
+	RefreshTiles(building->x - 1, building->y - 1, building->x + width, building->y + height);
+}
+
+void RestoreCitySnapshot(CityContext* city, const CitySnapshot* snapshot)
+{
+	TRACE_ZONE("RestoreCitySnapshot");
+	CurrentCityScope scope(city);
+	uint8_t* state = (uint8_t*)&City.state;
+	Building previousBuildings[MAX_BUILDINGS];
+	uint8_t previousTerrainType = City.state.terrainType;
+	CitySnapshotDiff changes;
+
+	memcpy(previousBuildings, City.state.buildings, sizeof(previousBuildings));
+	memset(&changes, 0, sizeof(changes));
+
+	// Only the blocks which differ from the city are copied
+	for (size_t n = 0; n < CITY_SNAPSHOT_NUM_BLOCKS; n++)
+	{
+		uint8_t* data = state + n * CITY_SNAPSHOT_BLOCK_SIZE;
+
+		if (DiffBlock(data, snapshot->blocks[n]->data, n, &changes))
+		{
+			memcpy(data, snapshot->blocks[n]->data, GetBlockSize(n));
+		}
+	}
+
+	City.randVal = snapshot->randVal;
+#ifdef USE_COUNTER_RNG
+	City.legacyRandom = snapshot->legacyRandom;
+#endif
+
+	// The caches worked out from GameState end up the same as ResetSimulationCaches would leave them, only
+	// redoing what the changed rows and buildings touch
+	bool roadsChanged = AnyChanged(changes.changedRows, sizeof(changes.changedRows));
+	bool buildingsChanged = AnyChanged((const uint8_t*)changes.changedBuildings, sizeof(changes.changedBuildings));
+
+	if (roadsChanged || buildingsChanged)
+	{
+		ResetRoadConnections();
+		RebuildBuildingIndex();
+	}
+
+	for (int n = 0; buildingsChanged && n < MAX_BUILDINGS; n++)
+	{
+		if (IsBuildingChanged(&changes, n))
+		{
+			Building* building = &City.state.buildings[n];
+			UpdateBuildingCaches(building);
+
+#ifdef USE_COVERAGE_MAPS
+			// Coverage only notices sources starting or stopping, not moving to another slot's old place
+			if (building->x != previousBuildings[n].x || building->y != previousBuildings[n].y)
+				City.coverageDirty = true;
+#endif
+		}
+	}
+
+	if (changes.numChangedBlocks)
+	{
+		CountPopulation();
+	}
+
+	// The work in progress goes back last, over anything the building updates marked to be redone
+	for (size_t n = 0; n < NUM_PROGRESS_BLOCKS; n++)
+	{
+		uint8_t* data;
+		size_t size = GetProgressBlock(city, n, &data);
+
+		if (memcmp(data, snapshot->progressBlocks[n]->data, size))
+		{
+			memcpy(data, snapshot->progressBlocks[n]->data, size);
+			changes.numChangedProgressBlocks++;
+		}
+	}
+
+	if (!changes.numChangedBlocks && !changes.numChangedProgressBlocks)
+		return;
+
+	// The interface is left as it is, the tiles it shows are refreshed where anything changed. Heavy traffic
+	// worked out along the roads can change anywhere
+#ifdef USE_TRAFFIC_FLOW
+	bool refreshAllTiles = true;
+#else
+	bool refreshAllTiles = City.state.terrainType != previousTerrainType;
+#endif
+	if (refreshAllTiles)
+	{
+		ResetVisibleTileCache();
+		return;
+	}
+
+	for (int y = 0; roadsChanged && y < MAP_HEIGHT; y++)
+	{
+		// Road tiles join up with the ones above and below
+		if (IsRowChanged(&changes, y))
+		{
+			RefreshTiles(0, y - 1, MAP_WIDTH - 1, y + 1);
+		}
+	}
+
+	for (int n = 0; buildingsChanged && n < MAX_BUILDINGS; n++)
+	{
+		if (IsBuildingChanged(&changes, n))
+		{
+			RefreshBuildingSurroundings(&previousBuildings[n]);
+			RefreshBuildingSurroundings(&City.state.buildings[n]);
+		}
+	}
+}
+
+void DiffCitySnapshots(const CitySnapshot* a, const CitySnapshot* b, CitySnapshotDiff* diff)
+{
+	memset(diff, 0, sizeof(CitySnapshotDiff));
+
+	for (size_t n = 0; n < CITY_SNAPSHOT_NUM_BLOCKS; n++)
+	{
+		// Shared blocks can be skipped without looking at them
+		if (a->blocks[n] != b->blocks[n])
+		{
+			DiffBlock(a->blocks[n]->data, b->blocks[n]->data, n, diff);
+		}
+	}
+
+	for (size_t n = 0; n < NUM_PROGRESS_BLOCKS; n++)
+	{
+		if (a->progressBlocks[n] != b->progressBlocks[n] && memcmp(a->progressBlocks[n]->data, b->progressBlocks[n]->data, CITY_SNAPSHOT_BLOCK_SIZE))
+		{
+			diff->numChangedProgressBlocks++;
+		}
+	}
+
+	if (a->randVal != b->randVal)
+	{
+		diff->otherStateChanged = true;
+	}
+#ifdef USE_COUNTER_RNG
+	if (a->legacyRandom != b->legacyRandom)
+	{
+		diff->otherStateChanged = true;
+	}
+#endif
+}
+
+#endif
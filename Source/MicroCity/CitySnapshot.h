@@ -0,0 +1,48 @@
+#pragma once
+
+#include "City.h"
+
+#ifdef USE_CITY_SNAPSHOTS
+
+// A snapshot keeps a city's GameState, and the work the simulation has in progress, in blocks of this many
+// bytes. Snapshots taken from the same city share
+// the blocks which haven't changed, so a fork only copies the block pointers and anything written since.
+// Snapshots can be forked, diffed and discarded from any thread
+#define CITY_SNAPSHOT_BLOCK_SIZE 64
+#define CITY_SNAPSHOT_NUM_BLOCKS ((sizeof(GameState) + CITY_SNAPSHOT_BLOCK_SIZE - 1) / CITY_SNAPSHOT_BLOCK_SIZE)
+
+struct CitySnapshot;
+
+// What is different between two snapshots
+typedef struct
+{
+	uint8_t changedRows[(MAP_HEIGHT + 7) / 8];				// Connection map rows, a bit for each
+	uint32_t changedBuildings[(MAX_BUILDINGS + 31) / 32];	// Building slots, a bit for each
+	bool otherStateChanged;									// The date, money, budget, population...
+	uint16_t numChangedBlocks;
+	uint16_t numChangedProgressBlocks;						// Work in progress such as the power flood fill
+} CitySnapshotDiff;
+
+// Takes a snapshot of a city, sharing the blocks which are the same as in base. base can be nullptr, or
+// any earlier snapshot though the closer it is to the city the more is shared
+CitySnapshot* TakeCitySnapshot(CityContext* city, const CitySnapshot* base);
+
+// Another reference to the same state, to be discarded separately
+CitySnapshot* ForkCitySnapshot(const CitySnapshot* snapshot);
+void DiscardCitySnapshot(CitySnapshot* snapshot);
+
+// Puts the city back how it was, including the random number generator and whatever the simulation was part
+// way through (the power flood fill, the zone schedule, the traffic pass and the land value), so it carries on
+// exactly as it did when the snapshot was taken. Only the blocks which differ from the city are copied. The
+// caches worked out from GameState are left the same as ResetSimulationCaches would leave them: the buildings
+// and roads which changed are updated one at a time, though the building index is worked out again if any
+// did. Restoring the state a city is already in does nothing. The interface is left as it is apart from
+// refreshing the tiles which changed
+void RestoreCitySnapshot(CityContext* city, const CitySnapshot* snapshot);
+
+void DiffCitySnapshots(const CitySnapshot* a, const CitySnapshot* b, CitySnapshotDiff* diff);
+
+// How many blocks the work in progress takes on top of the GameState's CITY_SNAPSHOT_NUM_BLOCKS
+size_t GetCitySnapshotProgressBlocks(void);
+
+#endif
@@ -1,16 +1,30 @@
 #include "Game.h"
+#include "Bits.h"
+#include "City.h"
 #include "Connectivity.h"
 #include "Building.h"
+#include "Simulation.h"
+#include "Trace.h"
+#include <string.h>
 
 void PowerFloodFill(uint8_t x, uint8_t y);
 uint8_t* GetPowerGrid();
 
+#ifdef USE_SIMULATION_SCHEDULER
+enum PowerFillState
+{
+	PowerFill_Idle,
+	PowerFill_Filling,
+	PowerFill_Finished
+};
+#endif
+
 uint8_t GetConnections(int x, int y)
 {
 	if (x >= 0 && x < MAP_WIDTH && y >= 0 && y < MAP_HEIGHT)
 	{
 		int index = y * MAP_WIDTH + x;
-		uint8_t mapVal = State.connectionMap[index >> 2];
+		uint8_t mapVal = City.state.connectionMap[index >> 2];
 		int shift = 2 * (index & 3);
 		return (mapVal >> shift) & 3;
 	}
@@ -26,11 +40,73 @@ void SetConnections(int x, int y, uint8_t newVal)
 		int shift = 2 * (index & 3);
 
 		index >>= 2;
-		uint8_t oldVal = State.connectionMap[index] & (~(3 << shift));
-		State.connectionMap[index] = oldVal | (newVal << shift);
+		uint8_t previousVal = City.state.connectionMap[index] >> shift;
+		uint8_t oldVal = City.state.connectionMap[index] & (~(3 << shift));
+		City.state.connectionMap[index] = oldVal | (newVal << shift);
+
+#ifdef USE_ROAD_CONNECTION_CACHE
+		if ((previousVal ^ newVal) & RoadMask)
+		{
+			City.numRoadTiles += (newVal & RoadMask) ? 1 : -1;
+			InvalidateRoadConnections(x, y);
+		}
+#endif
+#ifdef USE_TRAFFIC_FLOW
+		if ((previousVal ^ newVal) & RoadMask)
+		{
+			InvalidateTrafficRoutes();
+		}
+#endif
+#ifdef USE_ZONE_SCHEDULER
+		if ((previousVal ^ newVal) & RoadMask)
+		{
+			InvalidateZoneSchedule();
+		}
+#endif
+#ifdef USE_SIMULATION_SCHEDULER
+		if (((previousVal ^ newVal) & PowerlineMask) && City.powerFillState != PowerFill_Idle)
+		{
+			RestartPowerConnectivity();
+		}
+#endif
 	}
 }
 
+// Each tile's road bit is the low bit of its pair
+static inline int CountRoadBits(uint32_t word)
+{
+	return CountSetBits(word & 0x55555555u);
+}
+
+int CountRoadTiles()
+{
+	const int mapSize = sizeof(City.state.connectionMap);
+	const int numWords = mapSize / sizeof(uint32_t);
+	int count = 0;
+
+	for (int n = 0; n < numWords; n++)
+	{
+		uint32_t word;
+		memcpy(&word, &City.state.connectionMap[n * sizeof(uint32_t)], sizeof(word));
+		count += CountRoadBits(word);
+	}
+	for (int n = numWords * sizeof(uint32_t); n < mapSize; n++)
+	{
+		count += CountRoadBits(City.state.connectionMap[n]);
+	}
+
+	return count;
+}
+
+int GetNumRoadTiles()
+{
+#ifdef USE_ROAD_CONNECTION_CACHE
+	return City.numRoadTiles;
+#else
+	return CountRoadTiles();
+#endif
+}
+
 const uint8_t TileVariants[] PROGMEM =
 {
 	0, 1, 0, 5, 1, 1, 2, 9, 0, 4, 0, 8, 3, 7, 6, 10
@@ -127,33 +203,129 @@ inline void SetTilePowered(uint8_t x, uint8_t y)
 	GetPowerGrid()[index >> 3] |= mask;
 }
 
-void CalculatePowerConnectivity()
+static void ClearPowerGrid()
 {
-	// Clear power from grid
 	for (int n = 0; n < MAP_WIDTH * MAP_HEIGHT / 8; n++)
 	{
 		GetPowerGrid()[n] = 0;
 	}
+}
 
-	// Flood fill from power plants
+// Set powered flags on buildings
+static void SetBuildingPower()
+{
+#ifdef USE_BUILDING_INDEX
+	for (int n = 0; n < City.indexedBuildings.count; n++)
+	{
+		if (City.indexedBuildings.type[n])
+		{
+			Building* building = &City.state.buildings[City.indexedBuildings.slot[n]];
+			building->hasPower = IsTilePowered(City.indexedBuildings.x[n], City.indexedBuildings.y[n]);
+			UpdateBuildingCaches(building);
+		}
+	}
+#else
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		if (State.buildings[n].type == Powerplant)
+		if (City.state.buildings[n].type)
+		{
+			City.state.buildings[n].hasPower = IsTilePowered(City.state.buildings[n].x, City.state.buildings[n].y);
+			UpdateBuildingCaches(&City.state.buildings[n]);
+		}
+	}
+#endif
+}
+
+#ifdef USE_SIMULATION_SCHEDULER
+
+#ifdef USE_FIXED_MEMORY_FILL
+#error The power fill can only be split up with the stack based flood fill
+#endif
+
+static uint16_t FillPowerSpans(uint16_t stackSize, uint16_t* maxSpans);
+
+void CalculatePowerConnectivity()
+{
+	TRACE_ZONE("CalculatePowerConnectivity");
+	UpdatePowerConnectivity(POWER_FILL_UNLIMITED);
+	City.powerFillState = PowerFill_Idle;
+}
+
+bool UpdatePowerConnectivity(uint16_t maxSpans)
+{
+	TRACE_ZONE("UpdatePowerConnectivity");
+	if (City.powerFillState == PowerFill_Idle)
+	{
+		RestartPowerConnectivity();
+	}
+
+	while (City.powerFillState == PowerFill_Filling)
+	{
+		if (City.powerFillStackSize)
+		{
+			City.powerFillStackSize = FillPowerSpans(City.powerFillStackSize, &maxSpans);
+			if (City.powerFillStackSize)
+				return false;
+		}
+
+		// Flood fill from power plants
+		while (City.powerFillNextSlot < MAX_BUILDINGS && City.state.buildings[City.powerFillNextSlot].type != Powerplant)
 		{
-			PowerFloodFill(State.buildings[n].x, State.buildings[n].y);
+			City.powerFillNextSlot++;
+		}
+
+		if (City.powerFillNextSlot == MAX_BUILDINGS)
+		{
+			SetBuildingPower();
+			City.powerFillState = PowerFill_Finished;
+		}
+		else
+		{
+			uint8_t* stack = GetPowerGrid() + (MAP_WIDTH * MAP_HEIGHT / 8);
+			stack[0] = City.state.buildings[City.powerFillNextSlot].x;
+			stack[1] = City.state.buildings[City.powerFillNextSlot].y;
+			City.powerFillStackSize = 1;
+			City.powerFillNextSlot++;
 		}
 	}
 
-	// Set powered flags on buildings
+	return true;
+}
+
+void CancelPowerConnectivity()
+{
+	City.powerFillState = PowerFill_Idle;
+}
+
+void RestartPowerConnectivity()
+{
+	ClearPowerGrid();
+	City.powerFillState = PowerFill_Filling;
+	City.powerFillNextSlot = 0;
+	City.powerFillStackSize = 0;
+}
+
+#else
+
+void CalculatePowerConnectivity()
+{
+	TRACE_ZONE("CalculatePowerConnectivity");
+	ClearPowerGrid();
+
+	// Flood fill from power plants
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		if (State.buildings[n].type)
+		if (City.state.buildings[n].type == Powerplant)
 		{
-			State.buildings[n].hasPower = IsTilePowered(State.buildings[n].x, State.buildings[n].y);
+			PowerFloodFill(City.state.buildings[n].x, City.state.buildings[n].y);
 		}
 	}
+
+	SetBuildingPower();
 }
 
+#endif
+
 #ifdef USE_FIXED_MEMORY_FILL
 
 // Power flood fill method is based on the Wikipedia 'Fixed memory method (right hand fill method)'
@@ -261,6 +433,7 @@ void FillMoveForward(uint8_t* x, uint8_t* y, uint8_t dir)
 
 void PowerFloodFill(uint8_t x, uint8_t y)
 {
+	TRACE_ZONE("PowerFloodFill");
 	uint8_t fillDir = FILL_NORTH;
 	uint8_t mark1X = 0xff, mark1Y = 0xff, mark1Dir = FILL_NORTH;
 	uint8_t mark2X = 0xff, mark2Y = 0xff, mark2Dir = FILL_NORTH;
@@ -431,17 +604,19 @@ void PowerFloodFill(uint8_t x, uint8_t y)
 	stackPtr--; px = *stackPtr; \
 	stackSize--;
 
-void PowerFloodFill(uint8_t x, uint8_t y)
+// Pops positions off the stack after the grid and fills the column spans they are in, pushing the
+// spans either side. Stops when the stack is empty or maxSpans have been filled, returns what's left
+static uint16_t FillPowerSpans(uint16_t stackSize, uint16_t* maxSpans)
 {
 	uint8_t* grid = (uint8_t*)GetPowerGrid();
-	uint8_t* stackPtr = grid + (MAP_WIDTH * MAP_HEIGHT / 8);
-	uint8_t stackSize = 0;
-
-	STACK_PUSH(x, y);
+	uint8_t* stackPtr = grid + (MAP_WIDTH * MAP_HEIGHT / 8) + stackSize * 2;
+	uint8_t x, y;
 
-	while (stackSize)
+	while (stackSize && *maxSpans)
 	{
 		STACK_POP(x, y);
+		if (*maxSpans != POWER_FILL_UNLIMITED)
+			(*maxSpans)--;
 		int8_t y1 = y;
 
 		while (y1 >= 0 && (GetConnections(x, y1) & PowerlineMask) && !IsTilePowered(x, y1))
@@ -481,6 +656,19 @@ void PowerFloodFill(uint8_t x, uint8_t y)
 			y1++;
 		}
 	}
+
+	return stackSize;
+}
+
+void PowerFloodFill(uint8_t x, uint8_t y)
+{
+	TRACE_ZONE("PowerFloodFill");
+	uint8_t* stack = GetPowerGrid() + (MAP_WIDTH * MAP_HEIGHT / 8);
+	uint16_t maxSpans = POWER_FILL_UNLIMITED;
+
+	stack[0] = x;
+	stack[1] = y;
+	FillPowerSpans(1, &maxSpans);
 }
 
 #endif
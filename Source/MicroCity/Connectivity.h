@@ -11,6 +11,27 @@ enum ConnectivityMask
 uint8_t GetConnections(int x, int y);
 void SetConnections(int x, int y, uint8_t newVal);
 void CalculatePowerConnectivity(void);
+
+#define POWER_FILL_UNLIMITED 0xffff
+
+#ifdef USE_SIMULATION_SCHEDULER
+// Works on the power flood fill for up to maxSpans column spans, starting one if there isn't one going.
+// Returns true once it has finished and the buildings' power has been set, the next
+// CalculatePowerConnectivity then uses the result instead of filling again
+bool UpdatePowerConnectivity(uint16_t maxSpans);
+
+// Starts the fill again, called when a power line changes part way through
+void RestartPowerConnectivity(void);
+
+// Drops any fill in progress, for when City.state has been replaced
+void CancelPowerConnectivity(void);
+#endif
 int GetConnectivityTileVariant(int x, int y, uint8_t mask);
 bool IsSuitableForBridgedTile(int x, int y, uint8_t mask);
 uint8_t* GetPowerGrid();
+
+// Counts the road tiles straight from the packed connection map, a word at a time
+int CountRoadTiles(void);
+
+// Desktop builds keep a running count as SetConnections changes the map, the Arduboy counts them
+int GetNumRoadTiles(void);
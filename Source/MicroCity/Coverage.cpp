@@ -0,0 +1,126 @@
+#include "City.h"
+#include "Coverage.h"
+#include "Trace.h"
+
+#ifdef USE_COVERAGE_MAPS
+
+#define NO_COVERAGE 0xff
+
+enum CoverageSourceFlags
+{
+	PoliceCoverageFlag = 1,
+	FireCoverageFlag = 2
+};
+
+static uint8_t GetCoverageSourceFlags(Building* building)
+{
+	return (IsPoliceCoverageSource(building) ? PoliceCoverageFlag : 0) | (IsFireCoverageSource(building) ? FireCoverageFlag : 0);
+}
+
+static inline uint8_t MinDistance(uint8_t distance, uint8_t neighbourDistance)
+{
+	return neighbourDistance < distance - 1 ? neighbourDistance + 1 : distance;
+}
+
+// Two pass Manhattan distance transform, the first pass carries distances down and to the right
+// and the second pass up and to the left
+static void TransformDistanceMap(uint8_t* map)
+{
+	for (int y = 0; y < MAP_HEIGHT; y++)
+	{
+		for (int x = 0; x < MAP_WIDTH; x++)
+		{
+			uint8_t* tile = &map[y * MAP_WIDTH + x];
+			if (x > 0)
+				*tile = MinDistance(*tile, tile[-1]);
+			if (y > 0)
+				*tile = MinDistance(*tile, tile[-MAP_WIDTH]);
+		}
+	}
+
+	for (int y = MAP_HEIGHT - 1; y >= 0; y--)
+	{
+		for (int x = MAP_WIDTH - 1; x >= 0; x--)
+		{
+			uint8_t* tile = &map[y * MAP_WIDTH + x];
+			if (x < MAP_WIDTH - 1)
+				*tile = MinDistance(*tile, tile[1]);
+			if (y < MAP_HEIGHT - 1)
+				*tile = MinDistance(*tile, tile[MAP_WIDTH]);
+		}
+	}
+}
+
+void UpdateBuildingCoverage(Building* building)
+{
+	uint8_t* sourceFlags = &City.coverageSources[building - City.state.buildings];
+	uint8_t newSourceFlags = GetCoverageSourceFlags(building);
+
+	if (*sourceFlags != newSourceFlags)
+	{
+		*sourceFlags = newSourceFlags;
+		City.coverageDirty = true;
+	}
+}
+
+void UpdateCoverage()
+{
+	if (!City.coverageDirty)
+		return;
+
+	TRACE_ZONE("UpdateCoverage");
+
+	memset(City.policeDistanceMap, NO_COVERAGE, sizeof(City.policeDistanceMap));
+	memset(City.fireDeptDistanceMap, NO_COVERAGE, sizeof(City.fireDeptDistanceMap));
+
+	bool hasPolice = false;
+	bool hasFireDept = false;
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+		City.coverageSources[n] = GetCoverageSourceFlags(building);
+
+		if (City.coverageSources[n] & PoliceCoverageFlag)
+		{
+			City.policeDistanceMap[building->y * MAP_WIDTH + building->x] = 0;
+			hasPolice = true;
+		}
+		if (City.coverageSources[n] & FireCoverageFlag)
+		{
+			City.fireDeptDistanceMap[building->y * MAP_WIDTH + building->x] = 0;
+			hasFireDept = true;
+		}
+	}
+
+	if (hasPolice)
+	{
+		TransformDistanceMap(City.policeDistanceMap);
+	}
+	if (hasFireDept)
+	{
+		TransformDistanceMap(City.fireDeptDistanceMap);
+	}
+
+	City.coverageDirty = false;
+}
+
+void ResetCoverage()
+{
+	City.coverageDirty = true;
+	UpdateCoverage();
+}
+
+uint8_t GetPoliceDistance(uint8_t x, uint8_t y)
+{
+	UpdateCoverage();
+	return City.policeDistanceMap[y * MAP_WIDTH + x];
+}
+
+uint8_t GetFireDeptDistance(uint8_t x, uint8_t y)
+{
+	UpdateCoverage();
+	return City.fireDeptDistanceMap[y * MAP_WIDTH + x];
+}
+
+#endif
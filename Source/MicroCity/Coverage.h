@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Game.h"
+
+// Police stations only cover their area while they are running, fire departments send out
+// engines as long as they have power
+inline bool IsPoliceCoverageSource(Building* building)
+{
+	return building->type == PoliceDept && building->hasPower && !building->onFire;
+}
+
+inline bool IsFireCoverageSource(Building* building)
+{
+	return building->type == FireDept && building->hasPower;
+}
+
+#ifdef USE_COVERAGE_MAPS
+
+// Desktop builds keep maps of the Manhattan distance from every tile to the closest police station
+// and fire department. They are rebuilt with a distance transform at the start of the month after the
+// power has been updated, or before the next lookup when a station changes part way through a month.
+// UpdateBuildingCoverage must be called whenever anything the source checks above depend on changes
+void UpdateBuildingCoverage(Building* building);
+void UpdateCoverage(void);
+void ResetCoverage(void);
+
+// 0xff when there are no stations
+uint8_t GetPoliceDistance(uint8_t x, uint8_t y);
+uint8_t GetFireDeptDistance(uint8_t x, uint8_t y);
+
+#else
+
+inline void UpdateBuildingCoverage(Building* building) {}
+inline void UpdateCoverage() {}
+inline void ResetCoverage() {}
+
+#endif
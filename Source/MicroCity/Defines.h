@@ -1,6 +1,12 @@
 #pragma once
 
-#if _WIN32
+// Desktop builds (the SDL Windows build and the CMake headless build) share the same
+// platform shims, everything else is assumed to be the Arduboy
+#if defined(_WIN32) || defined(MICROCITY_HEADLESS)
+#define MICROCITY_DESKTOP 1
+#endif
+
+#ifdef MICROCITY_DESKTOP
 #include <stdint.h>
 #include <string.h>
 #define PROGMEM
@@ -17,7 +23,7 @@
 #define TILE_SIZE 8
 #define TILE_SIZE_SHIFT 3
 
-#ifdef _WIN32
+#ifdef MICROCITY_DESKTOP
 //#define DISPLAY_WIDTH 192
 //#define DISPLAY_HEIGHT 192
 #define DISPLAY_WIDTH 128
@@ -40,6 +46,78 @@
 
 #define MAX_BUILDINGS 130
 
+// Desktop builds keep a bucketed spatial index of the buildings for neighbourhood queries, per tile
+// pollution and police / fire coverage maps and a count of the roads next to each building. The
+// Arduboy doesn't have the RAM to spare so works these out from the building list as it goes
+#ifdef MICROCITY_DESKTOP
+#define USE_BUILDING_INDEX
+#define BUILDING_INDEX_CELL_SHIFT 4
+#define USE_POLLUTION_FIELD
+#define USE_COVERAGE_MAPS
+#define USE_ROAD_CONNECTION_CACHE
+#endif
+
+// Desktop builds can also simulate a whole month at once with the zones scored on worker threads
+#ifdef MICROCITY_DESKTOP
+#define USE_THREAD_POOL
+#define USE_MONTH_SIMULATION
+#endif
+
+// Desktop cities store a seed for a counter based random number generator, the Arduboy and
+// cities saved before the seed was added keep using the LFSR
+#ifdef MICROCITY_DESKTOP
+#define USE_COUNTER_RNG
+#endif
+
+// Desktop builds can have more than one city at a time, each thread works on its current city
+#ifdef MICROCITY_DESKTOP
+#define USE_CITY_CONTEXT
+#endif
+
+// Fast forwarding runs the simulation flat out without keeping the visible tiles up to date
+#ifdef MICROCITY_DESKTOP
+#define USE_FAST_FORWARD
+#endif
+
+// Desktop builds can give the simulation a time budget each frame instead of one step per tick, with
+// the power flood fill done a chunk at a time. The Arduboy's fill uses the display buffer so has to finish
+// within the frame
+#ifdef MICROCITY_DESKTOP
+#define USE_SIMULATION_SCHEDULER
+
+// Desktop builds keep track of which zones' inputs have changed so zones which have settled can be scored
+// less often. Every zone is still scored every month unless SetZoneSchedule asks for it
+#define USE_ZONE_SCHEDULER
+#endif
+
+// Desktop builds can keep track of which buildings are burning and tick every fire together on a cadence
+// of their own. The Arduboy ticks a fire when the month's pass over the buildings gets to it. Fires play out
+// differently so this is only on when built with MICROCITY_FIRE_TRACKING
+#if defined(MICROCITY_DESKTOP) && defined(MICROCITY_FIRE_TRACKING)
+#define USE_FIRE_TRACKING
+#endif
+
+// Desktop builds can route the trips from homes to jobs along the roads and count how many pass along each
+// road tile, which is where the heavy traffic is. The Arduboy marks the roads around any dense zone as busy.
+// Zones grow differently so this is only on when built with MICROCITY_TRAFFIC_FLOW
+#if defined(MICROCITY_DESKTOP) && defined(MICROCITY_TRAFFIC_FLOW)
+#define USE_TRAFFIC_FLOW
+#endif
+
+// Desktop builds can work out the land value from parks and water over the whole map once a month for the
+// homes to look up. The Arduboy adds up the parks around each home as it goes. Being close to water counts
+// as well and parks are counted over a square rather than a diamond, so this is only on when built with
+// MICROCITY_LAND_VALUE
+#if defined(MICROCITY_DESKTOP) && defined(MICROCITY_LAND_VALUE)
+#define USE_LAND_VALUE
+#endif
+
+// Desktop builds can take snapshots of a city to go back to or try things out from, with the parts of the
+// state which haven't changed shared between them
+#ifdef MICROCITY_DESKTOP
+#define USE_CITY_SNAPSHOTS
+#endif
+
 // How long a button has to be held before the first event repeats
 #define INPUT_REPEAT_TIME 10
 
@@ -1,8 +1,11 @@
 #include "Game.h"
+#include "City.h"
 #include "Draw.h"
 #include "Interface.h"
 #include "Font.h"
 #include "Strings.h"
+#include "Trace.h"
+#include "Traffic.h"
 
 const uint8_t TileImageData[] PROGMEM =
 {
@@ -11,11 +14,6 @@ const uint8_t TileImageData[] PROGMEM =
 
 #include "LogoBitmap.h"
 
-// Currently visible tiles are cached so they don't need to be recalculated between frames
-uint8_t VisibleTileCache[VISIBLE_TILES_X * VISIBLE_TILES_Y];
-int8_t CachedScrollX, CachedScrollY;
-uint8_t AnimationFrame = 0;
-
 // A map of which tiles should be on fire when a building is on fire
 #define FIREMAP_SIZE 16
 const uint8_t FireMap[FIREMAP_SIZE] PROGMEM =
@@ -36,10 +34,13 @@ inline uint8_t GetProcAtTile(uint8_t x, uint8_t y)
 
 bool HasHighTraffic(int x, int y)
 {
+#ifdef USE_TRAFFIC_FLOW
+	return GetRoadTraffic(x, y) >= SIM_HEAVY_TRAFFIC_LOAD;
+#else
 	// First check for buildings
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (building->type && building->heavyTraffic)
 		{
@@ -56,6 +57,7 @@ bool HasHighTraffic(int x, int y)
 	}
 
 	return false;
+#endif
 }
 
 uint8_t CalculateBuildingTile(Building* building, uint8_t x, uint8_t y)
@@ -119,7 +121,7 @@ uint8_t CalculateTile(int x, int y)
 	// First check for buildings
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (building->type)
 		{
@@ -172,10 +174,10 @@ inline uint8_t GetCachedTile(int x, int y)
 {
 	//// Uncomment to visualise power connectivity
 	/*
-	if (AnimationFrame & 4)
+	if (City.animationFrame & 4)
 	{
-		x += CachedScrollX;
-		y += CachedScrollY;
+		x += City.cachedScrollX;
+		y += City.cachedScrollY;
 		int index = y * MAP_WIDTH + x;
 		int mask = 1 << (index & 7);
 		uint8_t val = GetPowerGrid()[index >> 3];
@@ -186,22 +188,22 @@ inline uint8_t GetCachedTile(int x, int y)
 	////
 
 
-	uint8_t tile = VisibleTileCache[y * VISIBLE_TILES_X + x];
+	uint8_t tile = City.visibleTileCache[y * VISIBLE_TILES_X + x];
 
 	// Animate water tiles
 	if (tile >= FIRST_WATER_TILE && tile <= LAST_WATER_TILE)
 	{
-		tile = FIRST_WATER_TILE + ((tile - FIRST_WATER_TILE + (AnimationFrame >> 1)) & 3);
+		tile = FIRST_WATER_TILE + ((tile - FIRST_WATER_TILE + (City.animationFrame >> 1)) & 3);
 	}
 
 	// Animate fire tiles
 	if (tile >= FIRST_FIRE_TILE && tile <= LAST_FIRE_TILE)
 	{
-		tile = FIRST_FIRE_TILE + ((tile - FIRST_FIRE_TILE + (AnimationFrame >> 1)) & 3);
+		tile = FIRST_FIRE_TILE + ((tile - FIRST_FIRE_TILE + (City.animationFrame >> 1)) & 3);
 	}
 
 	// Animate traffic tiles
-	if ((AnimationFrame & 4) && tile >= FIRST_ROAD_TRAFFIC_TILE && tile <= LAST_ROAD_TRAFFIC_TILE)
+	if ((City.animationFrame & 4) && tile >= FIRST_ROAD_TRAFFIC_TILE && tile <= LAST_ROAD_TRAFFIC_TILE)
 	{
 		tile += 16;
 	}
@@ -209,29 +211,42 @@ inline uint8_t GetCachedTile(int x, int y)
 	return tile;
 }
 
+#ifdef USE_FAST_FORWARD
+void SuspendVisibleTileCache(bool suspend)
+{
+	City.tileCacheSuspended = suspend;
+	if (!suspend)
+	{
+		ResetVisibleTileCache();
+	}
+}
+#endif
+
 void ResetVisibleTileCache()
 {
-	CachedScrollX = UIState.scrollX >> TILE_SIZE_SHIFT;
-	CachedScrollY = UIState.scrollY >> TILE_SIZE_SHIFT;
+	TRACE_ZONE("ResetVisibleTileCache");
+	City.cachedScrollX = City.uiState.scrollX >> TILE_SIZE_SHIFT;
+	City.cachedScrollY = City.uiState.scrollY >> TILE_SIZE_SHIFT;
 
 	for (int y = 0; y < VISIBLE_TILES_Y; y++)
 	{
 		for (int x = 0; x < VISIBLE_TILES_X; x++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + CachedScrollX, y + CachedScrollY);
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + City.cachedScrollX, y + City.cachedScrollY);
 		}
 	}
 }
 
 void DrawTiles()
 {
+	TRACE_ZONE("DrawTiles");
 	int tileX = 0;
-	int offsetX = UIState.scrollX & (TILE_SIZE - 1);
+	int offsetX = City.uiState.scrollX & (TILE_SIZE - 1);
 
 	for (int col = 0; col < DISPLAY_WIDTH; col++)
 	{
 		int tileY = 0;
-		int offsetY = UIState.scrollY & (TILE_SIZE - 1);
+		int offsetY = City.uiState.scrollY & (TILE_SIZE - 1);
 		uint8_t currentTile = GetCachedTile(tileX, tileY);
 		uint8_t readBuf = pgm_read_byte(&GetTileData(currentTile)[offsetX]);
 		readBuf >>= offsetY;
@@ -261,14 +276,14 @@ void DrawTiles()
 
 void ScrollUp(int amount)
 {
-	CachedScrollY -= amount;
+	City.cachedScrollY -= amount;
 	int y = VISIBLE_TILES_Y - 1;
 
 	for (int n = 0; n < VISIBLE_TILES_Y - amount; n++)
 	{
 		for (int x = 0; x < VISIBLE_TILES_X; x++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = VisibleTileCache[(y - amount) * VISIBLE_TILES_X + x];
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = City.visibleTileCache[(y - amount) * VISIBLE_TILES_X + x];
 		}
 		y--;
 	}
@@ -277,21 +292,21 @@ void ScrollUp(int amount)
 	{
 		for (int x = 0; x < VISIBLE_TILES_X; x++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + CachedScrollX, y + CachedScrollY);
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + City.cachedScrollX, y + City.cachedScrollY);
 		}
 	}
 }
 
 void ScrollDown(int amount)
 {
-	CachedScrollY += amount;
+	City.cachedScrollY += amount;
 	int y = 0;
 
 	for (int n = 0; n < VISIBLE_TILES_Y - amount; n++)
 	{
 		for (int x = 0; x < VISIBLE_TILES_X; x++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = VisibleTileCache[(y + amount) * VISIBLE_TILES_X + x];
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = City.visibleTileCache[(y + amount) * VISIBLE_TILES_X + x];
 		}
 		y++;
 	}
@@ -301,7 +316,7 @@ void ScrollDown(int amount)
 	{
 		for (int x = 0; x < VISIBLE_TILES_X; x++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + CachedScrollX, y + CachedScrollY);
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + City.cachedScrollX, y + City.cachedScrollY);
 		}
 		y--;
 	}
@@ -309,14 +324,14 @@ void ScrollDown(int amount)
 
 void ScrollLeft(int amount)
 {
-	CachedScrollX -= amount;
+	City.cachedScrollX -= amount;
 	int x = VISIBLE_TILES_X - 1;
 
 	for (int n = 0; n < VISIBLE_TILES_X - amount; n++)
 	{
 		for (int y = 0; y < VISIBLE_TILES_Y; y++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = VisibleTileCache[y * VISIBLE_TILES_X + x - amount];
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = City.visibleTileCache[y * VISIBLE_TILES_X + x - amount];
 		}
 		x--;
 	}
@@ -325,21 +340,21 @@ void ScrollLeft(int amount)
 	{
 		for (int y = 0; y < VISIBLE_TILES_Y; y++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + CachedScrollX, y + CachedScrollY);
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + City.cachedScrollX, y + City.cachedScrollY);
 		}
 	}
 }
 
 void ScrollRight(int amount)
 {
-	CachedScrollX += amount;
+	City.cachedScrollX += amount;
 	int x = 0;
 
 	for (int n = 0; n < VISIBLE_TILES_X - amount; n++)
 	{
 		for (int y = 0; y < VISIBLE_TILES_Y; y++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = VisibleTileCache[y * VISIBLE_TILES_X + x + amount];
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = City.visibleTileCache[y * VISIBLE_TILES_X + x + amount];
 		}
 		x++;
 	}
@@ -349,7 +364,7 @@ void ScrollRight(int amount)
 	{
 		for (int y = 0; y < VISIBLE_TILES_Y; y++)
 		{
-			VisibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + CachedScrollX, y + CachedScrollY);
+			City.visibleTileCache[y * VISIBLE_TILES_X + x] = CalculateTile(x + City.cachedScrollX, y + City.cachedScrollY);
 		}
 		x--;
 	}
@@ -359,14 +374,14 @@ void DrawCursorRect(uint8_t cursorDrawX, uint8_t cursorDrawY, uint8_t cursorWidt
 {
 	for (int n = 0; n < cursorWidth; n++)
 	{
-		uint8_t colour = ((n + AnimationFrame) & 4) != 0 ? 1 : 0;
+		uint8_t colour = ((n + City.animationFrame) & 4) != 0 ? 1 : 0;
 		PutPixel(cursorDrawX + n, cursorDrawY + cursorHeight - 1, colour);
 		PutPixel(cursorDrawX + cursorWidth - n - 1, cursorDrawY, colour);
 	}
 
 	for (int n = 0; n < cursorHeight; n++)
 	{
-		uint8_t colour = ((n + AnimationFrame) & 4) != 0 ? 1 : 0;
+		uint8_t colour = ((n + City.animationFrame) & 4) != 0 ? 1 : 0;
 		PutPixel(cursorDrawX, cursorDrawY + n, colour);
 		PutPixel(cursorDrawX + cursorWidth - 1, cursorDrawY + cursorHeight - n - 1, colour);
 	}
@@ -377,9 +392,9 @@ void DrawCursor()
 	uint8_t cursorX, cursorY;
 	int cursorWidth = TILE_SIZE, cursorHeight = TILE_SIZE;
 
-	if (UIState.brush >= FirstBuildingBrush)
+	if (City.uiState.brush >= FirstBuildingBrush)
 	{
-		BuildingType buildingType = (BuildingType)(UIState.brush - FirstBuildingBrush + 1);
+		BuildingType buildingType = (BuildingType)(City.uiState.brush - FirstBuildingBrush + 1);
 		GetBuildingBrushLocation(buildingType, &cursorX, &cursorY);
 		const BuildingInfo* buildingInfo = GetBuildingInfo(buildingType);
 		cursorWidth *= pgm_read_byte(&buildingInfo->width);
@@ -387,13 +402,13 @@ void DrawCursor()
 	}
 	else
 	{
-		cursorX = UIState.selectX;
-		cursorY = UIState.selectY;
+		cursorX = City.uiState.selectX;
+		cursorY = City.uiState.selectY;
 	}
 
 	int cursorDrawX, cursorDrawY;
-	cursorDrawX = (cursorX * 8) - UIState.scrollX;
-	cursorDrawY = (cursorY * 8) - UIState.scrollY;
+	cursorDrawX = (cursorX * 8) - City.uiState.scrollX;
+	cursorDrawY = (cursorY * 8) - City.uiState.scrollY;
 
 	if (cursorDrawX >= 0 && cursorDrawY >= 0 && cursorDrawX + cursorWidth < DISPLAY_WIDTH && cursorDrawY + cursorHeight < DISPLAY_HEIGHT)
 	{
@@ -403,26 +418,26 @@ void DrawCursor()
 
 void AnimatePowercuts()
 {
-	bool showPowercut = (AnimationFrame & 8) != 0;
+	bool showPowercut = (City.animationFrame & 8) != 0;
 
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 
 		if (building->type && building->type != Park && !IsRubble(building->type))
 		{
-			int screenX = building->x + 1 - CachedScrollX;
-			int screenY = building->y + 1 - CachedScrollY;
+			int screenX = building->x + 1 - City.cachedScrollX;
+			int screenY = building->y + 1 - City.cachedScrollY;
 
 			if (screenX >= 0 && screenY >= 0 && screenX < VISIBLE_TILES_X && screenY < VISIBLE_TILES_Y)
 			{
 				if (showPowercut && !building->hasPower)
 				{
-					VisibleTileCache[screenY * VISIBLE_TILES_X + screenX] = POWERCUT_TILE;
+					City.visibleTileCache[screenY * VISIBLE_TILES_X + screenX] = POWERCUT_TILE;
 				}
 				else
 				{
-					VisibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateBuildingTile(building, 1, 1);
+					City.visibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateBuildingTile(building, 1, 1);
 				}
 			}
 		}
@@ -432,28 +447,40 @@ void AnimatePowercuts()
 
 void RefreshTile(uint8_t x, uint8_t y)
 {
-	int screenX = x - CachedScrollX;
-	int screenY = y - CachedScrollY;
+#ifdef USE_FAST_FORWARD
+	if (City.tileCacheSuspended)
+		return;
+#endif
+	int screenX = x - City.cachedScrollX;
+	int screenY = y - City.cachedScrollY;
 
 	if (screenX >= 0 && screenY >= 0 && screenX < VISIBLE_TILES_X && screenY < VISIBLE_TILES_Y)
 	{
-		VisibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateTile(x, y);
+		City.visibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateTile(x, y);
 	}
 }
 
 void SetTile(uint8_t x, uint8_t y, uint8_t tile)
 {
-	int screenX = x - CachedScrollX;
-	int screenY = y - CachedScrollY;
+#ifdef USE_FAST_FORWARD
+	if (City.tileCacheSuspended)
+		return;
+#endif
+	int screenX = x - City.cachedScrollX;
+	int screenY = y - City.cachedScrollY;
 
 	if (screenX >= 0 && screenY >= 0 && screenX < VISIBLE_TILES_X && screenY < VISIBLE_TILES_Y)
 	{
-		VisibleTileCache[screenY * VISIBLE_TILES_X + screenX] = tile;
+		City.visibleTileCache[screenY * VISIBLE_TILES_X + screenX] = tile;
 	}
 }
 
 void RefreshTileAndConnectedNeighbours(uint8_t x, uint8_t y)
 {
+#ifdef USE_FAST_FORWARD
+	if (City.tileCacheSuspended)
+		return;
+#endif
 	RefreshTile(x, y);
 
 	if (x > 0 && GetConnections(x - 1, y))
@@ -469,6 +496,10 @@ void RefreshTileAndConnectedNeighbours(uint8_t x, uint8_t y)
 
 void RefreshBuildingTiles(Building* building)
 {
+#ifdef USE_FAST_FORWARD
+	if (City.tileCacheSuspended)
+		return;
+#endif
 	const BuildingInfo* info = GetBuildingInfo(building->type);
 	uint8_t width = pgm_read_byte(&info->width);
 	uint8_t height = pgm_read_byte(&info->height);
@@ -479,12 +510,12 @@ void RefreshBuildingTiles(Building* building)
 		for (int i = 0; i < width; i++)
 		{
 			uint8_t x = building->x + i;
-			int screenX = x - CachedScrollX;
-			int screenY = y - CachedScrollY;
+			int screenX = x - City.cachedScrollX;
+			int screenY = y - City.cachedScrollY;
 
 			if (screenX >= 0 && screenY >= 0 && screenX < VISIBLE_TILES_X && screenY < VISIBLE_TILES_Y)
 			{
-				VisibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateBuildingTile(building, i, j);
+				City.visibleTileCache[screenY * VISIBLE_TILES_X + screenX] = CalculateBuildingTile(building, i, j);
 			}
 		}
 	}
@@ -557,7 +588,7 @@ const char FireReportedStr[] PROGMEM = "Fire reported!";
 
 void DrawUI()
 {
-	if (UIState.state == ShowingToolbar)
+	if (City.uiState.state == ShowingToolbar)
 	{
 		uint8_t buttonX = 1;
 
@@ -570,20 +601,20 @@ void DrawUI()
 			buttonX += TILE_SIZE + 1;
 		}
 
-		DrawCursorRect(UIState.selection * (TILE_SIZE + 1), DISPLAY_HEIGHT - TILE_SIZE - 2, TILE_SIZE + 2, TILE_SIZE + 2);
-		const char* currentSelection = GetToolbarString(UIState.selection);
+		DrawCursorRect(City.uiState.selection * (TILE_SIZE + 1), DISPLAY_HEIGHT - TILE_SIZE - 2, TILE_SIZE + 2, TILE_SIZE + 2);
+		const char* currentSelection = GetToolbarString(City.uiState.selection);
 		DrawString(currentSelection, 1, DISPLAY_HEIGHT - FONT_HEIGHT - TILE_SIZE - 2);
 
 		uint16_t cost = 0;
 
-		switch (UIState.selection)
+		switch (City.uiState.selection)
 		{
 		case 0: cost = BULLDOZER_COST; break;
 		case 1: cost = ROAD_COST; break;
 		case 2: cost = POWERLINE_COST; break;
 		default:
 		{
-			int buildingIndex = 1 + UIState.selection - FirstBuildingBrush;
+			int buildingIndex = 1 + City.uiState.selection - FirstBuildingBrush;
 			if (buildingIndex < Num_BuildingTypes)
 			{
 				const BuildingInfo* buildingInfo = GetBuildingInfo(buildingIndex);
@@ -597,13 +628,13 @@ void DrawUI()
 			DrawCurrency(cost, DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - FONT_HEIGHT - TILE_SIZE - 2);
 		}
 	}
-	else if (UIState.state == InGameDisaster)
+	else if (City.uiState.state == InGameDisaster)
 	{
 		int strLen = strlen_P(FireReportedStr);
 		int x = DISPLAY_WIDTH / 2 - strLen * (FONT_WIDTH / 2);
 		DrawFilledRect(x - 1, DISPLAY_HEIGHT - TILE_SIZE - 2, 2 + strlen_P(FireReportedStr) * FONT_WIDTH + 2, TILE_SIZE + 2, 1);
 
-		if (UIState.selection & 4)
+		if (City.uiState.selection & 4)
 		{
 			DrawString(FireReportedStr, x, DISPLAY_HEIGHT - FONT_HEIGHT - 1);
 		}
@@ -611,29 +642,29 @@ void DrawUI()
 	else
 	{
 		// Current brush at bottom left
-		const char* currentSelection = GetToolbarString(UIState.brush);
+		const char* currentSelection = GetToolbarString(City.uiState.brush);
 		DrawFilledRect(0, DISPLAY_HEIGHT - TILE_SIZE - 2, TILE_SIZE + 2 + strlen_P(currentSelection) * FONT_WIDTH + 2, TILE_SIZE + 2, 1);
-		DrawTileAt(FIRST_BRUSH_TILE + UIState.brush, 1, DISPLAY_HEIGHT - TILE_SIZE - 1);
+		DrawTileAt(FIRST_BRUSH_TILE + City.uiState.brush, 1, DISPLAY_HEIGHT - TILE_SIZE - 1);
 		DrawString(currentSelection, TILE_SIZE + 2, DISPLAY_HEIGHT - FONT_HEIGHT - 1);
 	}
 
 	// Date at top left
 	DrawFilledRect(0, 0, FONT_WIDTH * 8 + 2, FONT_HEIGHT + 2, 1);
-	DrawString(GetMonthString(State.month), 1, 1);
-	DrawInt(State.year + 1900, FONT_WIDTH * 4 + 1, 1);
+	DrawString(GetMonthString(City.state.month), 1, 1);
+	DrawInt(City.state.year + 1900, FONT_WIDTH * 4 + 1, 1);
 
 	// Funds at top right
-	uint8_t currencyStrLen = DrawCurrency(State.money, DISPLAY_WIDTH - FONT_WIDTH - 1, 1);
+	uint8_t currencyStrLen = DrawCurrency(City.state.money, DISPLAY_WIDTH - FONT_WIDTH - 1, 1);
 	DrawRect(DISPLAY_WIDTH - 2 - currencyStrLen * FONT_WIDTH, 0, currencyStrLen * FONT_WIDTH + 2, FONT_HEIGHT + 2, 1);
 }
 
 void DrawInGame()
 {
 	// Check to see if scrolled to a new location and need to update the visible tile cache
-	int tileScrollX = UIState.scrollX >> TILE_SIZE_SHIFT;
-	int tileScrollY = UIState.scrollY >> TILE_SIZE_SHIFT;
-	int scrollDiffX = tileScrollX - CachedScrollX;
-	int scrollDiffY = tileScrollY - CachedScrollY;
+	int tileScrollX = City.uiState.scrollX >> TILE_SIZE_SHIFT;
+	int tileScrollY = City.uiState.scrollY >> TILE_SIZE_SHIFT;
+	int scrollDiffX = tileScrollX - City.cachedScrollX;
+	int scrollDiffY = tileScrollY - City.cachedScrollY;
 
 	if (scrollDiffX < 0)
 	{
@@ -685,7 +716,7 @@ void DrawInGame()
 
 	DrawTiles();
 
-	if (UIState.state == InGame || UIState.state == InGameDisaster)
+	if (City.uiState.state == InGame || City.uiState.state == InGameDisaster)
 	{
 		DrawCursor();
 	}
@@ -713,7 +744,7 @@ void DrawSaveLoadMenu()
 	uint8_t y = DISPLAY_HEIGHT / 2 - menuHeight / 2 + spacing / 2 + 2;
 	uint8_t x = DISPLAY_WIDTH / 2 - menuWidth / 2 + FONT_WIDTH;
 
-	uint8_t cursorRectY = y + spacing * UIState.selection - 2;
+	uint8_t cursorRectY = y + spacing * City.uiState.selection - 2;
 	DrawCursorRect(x - 2, cursorRectY, menuWidth - FONT_WIDTH * 2 + 4, FONT_HEIGHT + 4);
 
 	DrawString(SaveCityStr, x, y);
@@ -724,7 +755,7 @@ void DrawSaveLoadMenu()
 	y += spacing;
 	DrawString(AutoBudgetStr, x, y);
 
-	DrawString(UIState.autoBudget ? OnStr : OffStr, x + 12 * FONT_WIDTH, y);
+	DrawString(City.uiState.autoBudget ? OnStr : OffStr, x + 12 * FONT_WIDTH, y);
 }
 
 void DrawStartScreen()
@@ -741,7 +772,7 @@ void DrawStartScreen()
 	uint8_t y = logoY + logoHeight - 2;
 	uint8_t x = DISPLAY_WIDTH / 2 - FONT_WIDTH * 5;
 
-	uint8_t cursorRectY = y + spacing * UIState.selection - 2;
+	uint8_t cursorRectY = y + spacing * City.uiState.selection - 2;
 	DrawCursorRect(x - 2, cursorRectY, FONT_WIDTH * 10 + 4, FONT_HEIGHT + 4);
 
 	DrawString(NewCityStr, x, y);
@@ -760,10 +791,10 @@ void DrawNewCityMenu()
 	DrawFilledRect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, 1);
 
 	DrawFilledRect(DISPLAY_WIDTH / 2 - MAP_WIDTH / 2, mapY, MAP_WIDTH, MAP_HEIGHT, 0);
-	DrawBitmap(GetTerrainData(State.terrainType), DISPLAY_WIDTH / 2 - MAP_WIDTH / 2, mapY, MAP_WIDTH, MAP_HEIGHT);
+	DrawBitmap(GetTerrainData(City.state.terrainType), DISPLAY_WIDTH / 2 - MAP_WIDTH / 2, mapY, MAP_WIDTH, MAP_HEIGHT);
 	DrawRect(DISPLAY_WIDTH / 2 - MAP_WIDTH / 2 - 2, mapY - 2, MAP_WIDTH + 4, MAP_HEIGHT + 4, 0);
 
-	DrawString(GetTerrainDescription(State.terrainType), DISPLAY_WIDTH / 2 - FONT_WIDTH * 3, mapY + MAP_HEIGHT + 5);
+	DrawString(GetTerrainDescription(City.state.terrainType), DISPLAY_WIDTH / 2 - FONT_WIDTH * 3, mapY + MAP_HEIGHT + 5);
 	DrawString(LeftArrowStr, DISPLAY_WIDTH / 2 - MAP_WIDTH / 2 - 6 - FONT_WIDTH, DISPLAY_HEIGHT / 2 - FONT_HEIGHT / 2);
 	DrawString(RightArrowStr, DISPLAY_WIDTH / 2 + MAP_WIDTH / 2 + 6, DISPLAY_HEIGHT / 2 - FONT_HEIGHT / 2);
 }
@@ -790,43 +821,44 @@ void DrawBudgetMenu()
 	uint8_t x2 = DISPLAY_WIDTH / 2 + menuWidth / 2 - 2 - FONT_WIDTH;
 
 	DrawString(BudgetHeaderStr, x, y);
-	int year = State.year > 0 ? State.year + 1899 : 1900;
+	int year = City.state.year > 0 ? City.state.year + 1899 : 1900;
 	DrawInt(year, x + FONT_WIDTH * 18, y);
 	y += spacing + 2;
 
 	DrawString(TaxRateStr, x, y);
-	DrawInt(State.taxRate, x + FONT_WIDTH * 19, y);
+	DrawInt(City.state.taxRate, x + FONT_WIDTH * 19, y);
 	y += spacing;
 
 	DrawString(TaxesCollectedStr, x, y);
-	DrawCurrency(State.taxesCollected, x2, y);
+	DrawCurrency(City.state.taxesCollected, x2, y);
 	y += spacing;
 
 	DrawString(FireBudgetStr, x, y);
-	DrawCurrency(State.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
+	DrawCurrency(City.state.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
 	y += spacing;
 
 	DrawString(PoliceBudgetStr, x, y);
-	DrawCurrency(State.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
+	DrawCurrency(City.state.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
 	y += spacing;
 
 	DrawString(RoadBudgetStr, x, y);
-	DrawCurrency(State.roadBudget, x2, y);
+	DrawCurrency(City.state.roadBudget, x2, y);
 	y += spacing + 2;
 
 	DrawString(CashFlowStr, x, y);
-	DrawCurrency(State.taxesCollected - State.roadBudget - State.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST - State.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
+	DrawCurrency(City.state.taxesCollected - City.state.roadBudget - City.state.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST - City.state.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST, x2, y);
 	y += spacing;
 
-	if (UIState.selection < MIN_BUDGET_DISPLAY_TIME)
+	if (City.uiState.selection < MIN_BUDGET_DISPLAY_TIME)
 	{
-		UIState.selection++;
+		City.uiState.selection++;
 	}
 }
 
 void Draw()
 {
-	switch (UIState.state)
+	TRACE_ZONE("Draw");
+	switch (City.uiState.state)
 	{
 	case StartScreen:
 		DrawStartScreen();
@@ -847,7 +879,7 @@ void Draw()
 		break;
 	}
 
-	AnimationFrame++;
+	City.animationFrame++;
 
 }
 
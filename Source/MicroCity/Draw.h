@@ -17,3 +17,17 @@ void RefreshTile(uint8_t x, uint8_t y);
 void RefreshTileAndConnectedNeighbours(uint8_t x, uint8_t y);
 
 void SetTile(uint8_t x, uint8_t y, uint8_t tile);
+
+#ifdef USE_FAST_FORWARD
+// While suspended the refresh functions above do nothing, resuming rebuilds the whole cache
+void SuspendVisibleTileCache(bool suspend);
+#endif
+
+// Individual drawing steps, exposed so that they can be profiled separately
+uint8_t CalculateTile(int x, int y);
+void DrawTiles(void);
+void AnimatePowercuts(void);
+void ScrollUp(int amount);
+void ScrollDown(int amount);
+void ScrollLeft(int amount);
+void ScrollRight(int amount);
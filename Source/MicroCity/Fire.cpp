@@ -0,0 +1,118 @@
+#include "Bits.h"
+#include "City.h"
+#include "Fire.h"
+#include "Simulation.h"
+#include "Trace.h"
+
+#ifdef USE_FIRE_TRACKING
+
+#ifdef ENABLE_CHECKS
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+static inline void SetBuildingBit(uint32_t* set, int slot, bool value)
+{
+	uint32_t bit = 1u << (slot & 31);
+
+	if (value)
+		set[slot >> 5] |= bit;
+	else
+		set[slot >> 5] &= ~bit;
+}
+
+static bool IsBurning(Building* building)
+{
+	// Clearing burning rubble can leave the fire counter behind in an empty slot
+	return building->type && building->onFire;
+}
+
+void UpdateBuildingFire(Building* building)
+{
+	int slot = building - City.state.buildings;
+
+	SetBuildingBit(City.burningBuildings, slot, IsBurning(building));
+	SetBuildingBit(City.flammableBuildings, slot, CanCatchFire(building));
+}
+
+void ResetFires()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		UpdateBuildingFire(&City.state.buildings[n]);
+	}
+}
+
+void SimulateFires(uint8_t draw)
+{
+	TRACE_ZONE("SimulateFires");
+	uint32_t burning[BUILDING_SET_WORDS];
+	memcpy(burning, City.burningBuildings, sizeof(burning));
+
+	for (int n = 0; n < BUILDING_SET_WORDS; n++)
+	{
+		for (uint32_t word = burning[n]; word; word &= word - 1)
+		{
+			Building* building = &City.state.buildings[n * 32 + LowestSetBit(word)];
+
+			// An earlier fire in the same tick may have cleared it
+			if (IsBurning(building))
+			{
+				SimulateFire(building, draw);
+			}
+		}
+	}
+}
+
+Building* PickFlammableBuilding(uint16_t random)
+{
+	int count = 0;
+
+	for (int n = 0; n < BUILDING_SET_WORDS; n++)
+	{
+		count += CountSetBits(City.flammableBuildings[n]);
+	}
+
+	if (!count)
+		return nullptr;
+
+	int pick = random % count;
+
+	for (int n = 0; n < BUILDING_SET_WORDS; n++)
+	{
+		uint32_t word = City.flammableBuildings[n];
+		int wordCount = CountSetBits(word);
+
+		if (pick < wordCount)
+		{
+			while (pick--)
+			{
+				word &= word - 1;
+			}
+			return &City.state.buildings[n * 32 + LowestSetBit(word)];
+		}
+		pick -= wordCount;
+	}
+
+	return nullptr;
+}
+
+#ifdef ENABLE_CHECKS
+void CheckFires()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+		bool burning = (City.burningBuildings[n >> 5] >> (n & 31)) & 1;
+		bool flammable = (City.flammableBuildings[n >> 5] >> (n & 31)) & 1;
+
+		if (burning != IsBurning(building) || flammable != CanCatchFire(building))
+		{
+			fprintf(stderr, "Fire sets don't match building %d\n", n);
+			abort();
+		}
+	}
+}
+#endif
+
+#endif
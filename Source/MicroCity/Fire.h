@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Game.h"
+
+// Parks and rubble don't burn, and a building that is already on fire can't catch fire again
+inline bool CanCatchFire(Building* building)
+{
+	return building->type && building->type != Park && !IsRubble(building->type) && !building->onFire;
+}
+
+#ifdef USE_FIRE_TRACKING
+
+// How many simulation steps apart the fires are ticked, about once a month like the pass over the
+// buildings but with every fire ticked at the same time wherever its building is in the list
+#define FIRE_TICK_INTERVAL 128
+
+// Fire tracking builds keep sets of the buildings which are burning and the ones which could catch fire, so
+// fires can be ticked and started without going through every building. UpdateBuildingFire must be
+// called whenever a building's type or fire changes
+void UpdateBuildingFire(Building* building);
+void ResetFires(void);
+
+// Ticks every burning building in slot order. Only the buildings burning at the start are ticked, fires
+// spreading to a building start on the next tick. draw separates the ticks within a month
+void SimulateFires(uint8_t draw);
+
+// Picks a building which can catch fire using a random number, nullptr when there are none
+Building* PickFlammableBuilding(uint16_t random);
+
+#ifdef ENABLE_CHECKS
+// Aborts if the sets don't match the buildings
+void CheckFires(void);
+#endif
+
+#else
+
+inline void UpdateBuildingFire(Building* building) {}
+inline void ResetFires() {}
+
+#endif
@@ -1,9 +1,56 @@
 #include "Game.h"
+#include "City.h"
 #include "Draw.h"
 #include "Interface.h"
+#include "LandValue.h"
 #include "Simulation.h"
+#include "Trace.h"
 
-GameState State;
+#ifdef USE_CITY_CONTEXT
+#include <stdlib.h>
+#endif
+
+#ifdef USE_CITY_CONTEXT
+static CityContext MainCity;
+CITY_THREAD_LOCAL CityContext* CurrentCity = &MainCity;
+
+CityContext* GetMainCity()
+{
+	return &MainCity;
+}
+
+CityContext* CreateCity(uint32_t randomSeed)
+{
+	CityContext* city = (CityContext*)calloc(1, sizeof(CityContext));
+	InitGame(city);
+#ifdef USE_COUNTER_RNG
+	city->state.randomSeed = randomSeed;
+#endif
+	return city;
+}
+
+void DestroyCity(CityContext* city)
+{
+	free(city);
+}
+
+void InitGame(CityContext* city)
+{
+	CurrentCityScope scope(city);
+	InitGame();
+}
+
+void TickGame(CityContext* city)
+{
+	CurrentCityScope scope(city);
+	TickGame();
+}
+#else
+CityContext City;
+#endif
+
+// Where the LFSR starts. It never reaches zero so a city's randVal is zero until it is first used
+#define INITIAL_RAND_STATE 0xABC
 
 uint16_t GetRandFromSeed(uint16_t randVal)
 {
@@ -17,54 +64,138 @@ uint16_t GetRandFromSeed(uint16_t randVal)
 
 uint16_t GetRand()
 {
-	static uint16_t randVal = 0xABC;
+	City.randVal = GetRandFromSeed(GetRandState());
+
+	return City.randVal - 1;
+}
+
+uint16_t GetRandState()
+{
+	return City.randVal ? City.randVal : INITIAL_RAND_STATE;
+}
+
+void SetRandState(uint16_t randVal)
+{
+	City.randVal = randVal;
+}
+
+#ifdef USE_COUNTER_RNG
+// Squares: four rounds of squaring the counter multiplied by the key, keeping the middle bits each time
+static uint32_t Squares32(uint64_t counter, uint64_t key)
+{
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+	x = x * x + z;
+	x = (x >> 32) | (x << 32);
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+	return (uint32_t)((x * x + z) >> 32);
+}
+
+// The key should have bits set all the way through so the seed is spread out with splitmix64
+static uint64_t GetSquaresKey(uint32_t seed)
+{
+	uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (z ^ (z >> 31)) | 1;
+}
+
+void SetLegacyRandom(bool legacy)
+{
+	City.legacyRandom = legacy;
+}
+
+void SetNextCitySeed(uint32_t randomSeed)
+{
+	City.nextCitySeed = randomSeed;
+}
+
+static uint32_t TakeNextCitySeed()
+{
+	uint32_t randomSeed = City.nextCitySeed ? City.nextCitySeed : DEFAULT_CITY_SEED;
 
-	randVal = GetRandFromSeed(randVal);
+	// Mixed the same way as the key so starting another city from the menu gives a different seed, never 0
+	City.nextCitySeed = (uint32_t)GetSquaresKey(randomSeed);
+	return randomSeed;
+}
+#endif
 
-	return randVal - 1;
+uint16_t GetSimulationRand(uint8_t building, uint8_t purpose, uint8_t draw)
+{
+#ifdef USE_COUNTER_RNG
+	if (City.state.randomSeed)
+	{
+		uint32_t monthIndex = City.state.year * 12 + City.state.month;
+		uint64_t counter = ((uint64_t)monthIndex << 32) | ((uint32_t)building << 16) | ((uint32_t)purpose << 8) | draw;
+		return (uint16_t)(Squares32(counter, GetSquaresKey(City.state.randomSeed)) >> 16);
+	}
+#endif
+	return GetRand();
 }
 
 void InitGame()
 {
-	uint8_t* ptr = (uint8_t*)(&State);
+	uint8_t* ptr = (uint8_t*)(&City.state);
 	for (int n = 0; n < sizeof(GameState); n++)
 	{
 		*ptr = 0;
 		ptr++;
 	}
 
-	State.taxRate = STARTING_TAX_RATE;
-	State.timeToNextDisaster = MAX_TIME_BETWEEN_DISASTERS;
+	City.state.taxRate = STARTING_TAX_RATE;
+	City.state.timeToNextDisaster = MAX_TIME_BETWEEN_DISASTERS;
+
+#ifdef USE_COUNTER_RNG
+	if (!City.legacyRandom)
+	{
+		City.state.randomSeed = TakeNextCitySeed();
+	}
+#endif
 
 	ResetVisibleTileCache();
-	UIState.brush = RoadBrush; //FirstBuildingBrush + 1;
+	City.uiState.brush = RoadBrush; //FirstBuildingBrush + 1;
 	FocusTile(MAP_WIDTH / 2, MAP_HEIGHT / 2);
 
-	State.money = STARTING_FUNDS;
-	UIState.autoBudget = true;
+	City.state.money = STARTING_FUNDS;
+	City.uiState.autoBudget = true;
+
+	ResetSimulationCaches();
+}
+
+void SetTerrainType(uint8_t terrainType)
+{
+	City.state.terrainType = terrainType;
+	UpdateLandValue();
+	ResetVisibleTileCache();
 }
 
 void FocusTile(uint8_t x, uint8_t y)
 {
-	UIState.selectX = x;
-	UIState.selectY = y;
-	UIState.scrollX = UIState.selectX * 8 + TILE_SIZE / 2 - DISPLAY_WIDTH / 2;
-	UIState.scrollY = UIState.selectY * 8 + TILE_SIZE / 2 - DISPLAY_HEIGHT / 2;
+	City.uiState.selectX = x;
+	City.uiState.selectY = y;
+	City.uiState.scrollX = City.uiState.selectX * 8 + TILE_SIZE / 2 - DISPLAY_WIDTH / 2;
+	City.uiState.scrollY = City.uiState.selectY * 8 + TILE_SIZE / 2 - DISPLAY_HEIGHT / 2;
 }
 
 void TickGame()
 {
-	if (UIState.state == InGame || UIState.state == ShowingToolbar)
+	TRACE_ZONE("TickGame");
+	if (City.uiState.state == InGame || City.uiState.state == ShowingToolbar)
 	{
-		Simulate();
+		SimulateFrame();
 	}
-	if (UIState.state == InGameDisaster)
+	if (City.uiState.state == InGameDisaster)
 	{
-		if (UIState.selection == 0)
+		if (City.uiState.selection == 0)
 		{
-			UIState.state = InGame;
+			City.uiState.state = InGame;
 		}
-		else UIState.selection--;
+		else City.uiState.selection--;
 	}
 
 	ProcessInput();
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #endif
 #include <stdint.h>
+#include <stddef.h>
 #include "Defines.h"
 #include "Building.h"
 #include "Connectivity.h"
@@ -35,16 +36,67 @@ typedef struct
 	uint16_t timeToNextDisaster;
 
 	Building buildings[MAX_BUILDINGS];
+
+#ifdef USE_COUNTER_RNG
+	// 0 for cities from before there was a seed, which use GetRand instead
+	uint32_t randomSeed;
+#endif
 } GameState;
 
-extern GameState State;
+#ifdef USE_COUNTER_RNG
+// The size of GameState in saves and recordings from before the seed was added
+#define LEGACY_GAME_STATE_SIZE offsetof(GameState, randomSeed)
+#endif
 
 uint16_t GetRandFromSeed(uint16_t randVal);
 uint16_t GetRand();
 
+// What a random number in the simulation is used for, so draws for different things are independent
+enum RandomPurpose
+{
+	RandomPurpose_ZoneScore,
+	RandomPurpose_FireSpreadChance,
+	RandomPurpose_FireSpreadDirection,
+	RandomPurpose_FireFighting,
+	RandomPurpose_FireBurn,
+	RandomPurpose_Disaster,
+	RandomPurpose_DisasterTimer
+};
+
+// Random numbers for the simulation. Cities with a seed use a counter based generator, so each number
+// only depends on the seed, the month, the building (or simulation step) and what it is for, plus a draw
+// number for when more than one is needed. Otherwise they come from GetRand in call order
+uint16_t GetSimulationRand(uint8_t building, uint8_t purpose, uint8_t draw);
+
+#ifdef USE_COUNTER_RNG
+// New cities are given a seed unless legacy random numbers are turned on for the city, which is needed to
+// play back recordings made before there were seeds
+void SetLegacyRandom(bool legacy);
+
+// The seed InitGame gives the next new city, each city started after it gets one worked out from the last.
+// Without this the first city gets DEFAULT_CITY_SEED so tools and benchmarks are the same every run, the
+// game itself starts from the clock
+#define DEFAULT_CITY_SEED 0x055d02ae
+void SetNextCitySeed(uint32_t randomSeed);
+#endif
+
+// Random number generator state isn't part of GameState so is saved separately when needed (e.g. replays)
+uint16_t GetRandState();
+void SetRandState(uint16_t randVal);
+
 void InitGame(void);
 void TickGame(void);
 
+// Changes the terrain under the map and anything worked out from it
+void SetTerrainType(uint8_t terrainType);
+
+#ifdef USE_CITY_CONTEXT
+// The functions above work on the current city, these work on the one given
+struct CityContext;
+void InitGame(struct CityContext* city);
+void TickGame(struct CityContext* city);
+#endif
+
 void SaveCity(void);
 bool LoadCity(void);
 
@@ -0,0 +1,354 @@
+#include "InfluenceKernel.h"
+#include "Simulation.h"
+
+#ifdef USE_BUILDING_INDEX
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define USE_X86_INFLUENCE_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Building types fit in the low four bits, which is what the byte shuffle lookups use
+#define INFLUENCE_TABLE_SIZE 16
+
+enum DensityComparison
+{
+	OtherDensityBelow,
+	OtherDensityEqual,
+	OtherDensityAbove,
+	Num_DensityComparisons
+};
+
+// GetLocalInfluence only depends on the building types and which way the densities compare, so the
+// vector kernels look up the influence for each comparison from tables filled in from it
+typedef struct
+{
+	uint8_t influence[Num_DensityComparisons][INFLUENCE_TABLE_SIZE];	// Indexed by the other building's type
+	uint8_t numOtherTypes;
+	uint8_t otherTypes[INFLUENCE_TABLE_SIZE];	// The types with any influence, for kernels without shuffles
+} LocalInfluenceTable;
+
+static LocalInfluenceTable LocalInfluenceTables[INFLUENCE_TABLE_SIZE];
+
+static bool InfluenceKernelForced = false;
+static uint8_t SelectedInfluenceKernel = InfluenceKernel_Scalar;
+
+static int16_t SumLocalInfluenceScalar(const LocalInfluenceQuery* query, uint8_t start, uint8_t end)
+{
+	int16_t localInfluence = 0;
+
+	for (uint8_t n = start; n < end; n++)
+	{
+		uint8_t flags = City.indexedBuildings.flags[n];
+		uint8_t otherType = City.indexedBuildings.type[n];
+
+		if (City.indexedBuildings.slot[n] == query->slot || (flags & IndexedBuilding_OnFire) || !(flags & IndexedBuilding_RoadConnected)
+			|| !((flags & IndexedBuilding_HasPower) || otherType == Park))
+			continue;
+
+		uint8_t dx = query->x > City.indexedBuildings.x[n] ? query->x - City.indexedBuildings.x[n] : City.indexedBuildings.x[n] - query->x;
+		uint8_t dy = query->y > City.indexedBuildings.y[n] ? query->y - City.indexedBuildings.y[n] : City.indexedBuildings.y[n] - query->y;
+
+		if (dx + dy <= query->radius)
+		{
+			localInfluence += GetLocalInfluence(query->type, query->populationDensity, otherType, City.indexedBuildings.populationDensity[n]);
+		}
+	}
+
+	return localInfluence;
+}
+
+#ifdef USE_X86_INFLUENCE_KERNELS
+
+// Each lane works out whether its entry counts (running, connected, close enough and not the building
+// itself) and what influence it has, the influences are then added up with SAD against zero.
+// Entries are only ever added, so lanes past the end of the span are masked off rather than handled separately
+
+TARGET_SSE2 static int16_t SumLocalInfluenceSSE2(const LocalInfluenceQuery* query, uint8_t start, uint8_t end)
+{
+	const LocalInfluenceTable* table = &LocalInfluenceTables[query->type];
+	if (!table->numOtherTypes)
+		return 0;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i laneOffsets = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i lastEntry = _mm_set1_epi8((char)(end - 1));
+	const __m128i x = _mm_set1_epi8((char)query->x);
+	const __m128i y = _mm_set1_epi8((char)query->y);
+	const __m128i radius = _mm_set1_epi8((char)query->radius);
+	const __m128i slot = _mm_set1_epi8((char)query->slot);
+	const __m128i populationDensity = _mm_set1_epi8((char)query->populationDensity);
+	const __m128i runningFlagsMask = _mm_set1_epi8(IndexedBuilding_OnFire | IndexedBuilding_RoadConnected);
+	const __m128i runningFlags = _mm_set1_epi8(IndexedBuilding_RoadConnected);
+	const __m128i hasPowerFlag = _mm_set1_epi8(IndexedBuilding_HasPower);
+	const __m128i parkType = _mm_set1_epi8(Park);
+	__m128i total = zero;
+
+	for (int n = start; n < end; n += 16)
+	{
+		__m128i entry = _mm_add_epi8(_mm_set1_epi8((char)n), laneOffsets);
+		__m128i otherX = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.x[n]);
+		__m128i otherY = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.y[n]);
+		__m128i otherSlot = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.slot[n]);
+		__m128i otherType = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.type[n]);
+		__m128i otherDensity = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.populationDensity[n]);
+		__m128i flags = _mm_loadu_si128((const __m128i*)&City.indexedBuildings.flags[n]);
+
+		__m128i dx = _mm_or_si128(_mm_subs_epu8(x, otherX), _mm_subs_epu8(otherX, x));
+		__m128i dy = _mm_or_si128(_mm_subs_epu8(y, otherY), _mm_subs_epu8(otherY, y));
+		__m128i distance = _mm_adds_epu8(dx, dy);
+
+		__m128i counts = _mm_cmpeq_epi8(_mm_min_epu8(entry, lastEntry), entry);
+		counts = _mm_and_si128(counts, _mm_cmpeq_epi8(_mm_min_epu8(distance, radius), distance));
+		counts = _mm_andnot_si128(_mm_cmpeq_epi8(otherSlot, slot), counts);
+		counts = _mm_and_si128(counts, _mm_cmpeq_epi8(_mm_and_si128(flags, runningFlagsMask), runningFlags));
+		counts = _mm_and_si128(counts, _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(flags, hasPowerFlag), hasPowerFlag), _mm_cmpeq_epi8(otherType, parkType)));
+
+		__m128i equal = _mm_cmpeq_epi8(otherDensity, populationDensity);
+		__m128i atLeast = _mm_cmpeq_epi8(_mm_max_epu8(otherDensity, populationDensity), otherDensity);
+		__m128i above = _mm_andnot_si128(equal, atLeast);
+
+		__m128i influence = zero;
+		for (uint8_t t = 0; t < table->numOtherTypes; t++)
+		{
+			uint8_t type = table->otherTypes[t];
+			__m128i isType = _mm_cmpeq_epi8(otherType, _mm_set1_epi8((char)type));
+			__m128i typeInfluence = _mm_andnot_si128(atLeast, _mm_set1_epi8((char)table->influence[OtherDensityBelow][type]));
+			typeInfluence = _mm_or_si128(typeInfluence, _mm_and_si128(equal, _mm_set1_epi8((char)table->influence[OtherDensityEqual][type])));
+			typeInfluence = _mm_or_si128(typeInfluence, _mm_and_si128(above, _mm_set1_epi8((char)table->influence[OtherDensityAbove][type])));
+			influence = _mm_or_si128(influence, _mm_and_si128(isType, typeInfluence));
+		}
+
+		total = _mm_add_epi64(total, _mm_sad_epu8(_mm_and_si128(counts, influence), zero));
+	}
+
+	return (int16_t)(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total)));
+}
+
+TARGET_AVX2 static int16_t SumLocalInfluenceAVX2(const LocalInfluenceQuery* query, uint8_t start, uint8_t end)
+{
+	const LocalInfluenceTable* table = &LocalInfluenceTables[query->type];
+	if (!table->numOtherTypes)
+		return 0;
+
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i laneOffsets = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+		16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+	const __m256i lastEntry = _mm256_set1_epi8((char)(end - 1));
+	const __m256i x = _mm256_set1_epi8((char)query->x);
+	const __m256i y = _mm256_set1_epi8((char)query->y);
+	const __m256i radius = _mm256_set1_epi8((char)query->radius);
+	const __m256i slot = _mm256_set1_epi8((char)query->slot);
+	const __m256i populationDensity = _mm256_set1_epi8((char)query->populationDensity);
+	const __m256i runningFlagsMask = _mm256_set1_epi8(IndexedBuilding_OnFire | IndexedBuilding_RoadConnected);
+	const __m256i runningFlags = _mm256_set1_epi8(IndexedBuilding_RoadConnected);
+	const __m256i hasPowerFlag = _mm256_set1_epi8(IndexedBuilding_HasPower);
+	const __m256i parkType = _mm256_set1_epi8(Park);
+	const __m256i typeBits = _mm256_set1_epi8(INFLUENCE_TABLE_SIZE - 1);
+	const __m256i influenceBelow = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table->influence[OtherDensityBelow]));
+	const __m256i influenceEqual = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table->influence[OtherDensityEqual]));
+	const __m256i influenceAbove = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table->influence[OtherDensityAbove]));
+	__m256i total = zero;
+
+	for (int n = start; n < end; n += 32)
+	{
+		__m256i entry = _mm256_add_epi8(_mm256_set1_epi8((char)n), laneOffsets);
+		__m256i otherX = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.x[n]);
+		__m256i otherY = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.y[n]);
+		__m256i otherSlot = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.slot[n]);
+		__m256i otherType = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.type[n]);
+		__m256i otherDensity = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.populationDensity[n]);
+		__m256i flags = _mm256_loadu_si256((const __m256i*)&City.indexedBuildings.flags[n]);
+
+		__m256i dx = _mm256_or_si256(_mm256_subs_epu8(x, otherX), _mm256_subs_epu8(otherX, x));
+		__m256i dy = _mm256_or_si256(_mm256_subs_epu8(y, otherY), _mm256_subs_epu8(otherY, y));
+		__m256i distance = _mm256_adds_epu8(dx, dy);
+
+		__m256i counts = _mm256_cmpeq_epi8(_mm256_min_epu8(entry, lastEntry), entry);
+		counts = _mm256_and_si256(counts, _mm256_cmpeq_epi8(_mm256_min_epu8(distance, radius), distance));
+		counts = _mm256_andnot_si256(_mm256_cmpeq_epi8(otherSlot, slot), counts);
+		counts = _mm256_and_si256(counts, _mm256_cmpeq_epi8(_mm256_and_si256(flags, runningFlagsMask), runningFlags));
+		counts = _mm256_and_si256(counts, _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_and_si256(flags, hasPowerFlag), hasPowerFlag), _mm256_cmpeq_epi8(otherType, parkType)));
+
+		__m256i equal = _mm256_cmpeq_epi8(otherDensity, populationDensity);
+		__m256i atLeast = _mm256_cmpeq_epi8(_mm256_max_epu8(otherDensity, populationDensity), otherDensity);
+		__m256i above = _mm256_andnot_si256(equal, atLeast);
+
+		__m256i typeIndex = _mm256_and_si256(otherType, typeBits);
+		__m256i influence = _mm256_andnot_si256(atLeast, _mm256_shuffle_epi8(influenceBelow, typeIndex));
+		influence = _mm256_or_si256(influence, _mm256_and_si256(equal, _mm256_shuffle_epi8(influenceEqual, typeIndex)));
+		influence = _mm256_or_si256(influence, _mm256_and_si256(above, _mm256_shuffle_epi8(influenceAbove, typeIndex)));
+
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_and_si256(counts, influence), zero));
+	}
+
+	__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(total), _mm256_extracti128_si256(total, 1));
+	return (int16_t)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum)));
+}
+
+static bool CPUSupportsSSE2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool CPUSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// The OS also has to be saving the YMM registers
+	__cpuid(info, 1);
+	bool hasAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+	if (!hasAVX || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static const LocalInfluenceKernel InfluenceKernels[Num_InfluenceKernels] =
+{
+	SumLocalInfluenceScalar,
+#ifdef USE_X86_INFLUENCE_KERNELS
+	SumLocalInfluenceSSE2,
+	SumLocalInfluenceAVX2
+#else
+	nullptr,
+	nullptr
+#endif
+};
+
+static const char* const InfluenceKernelNames[Num_InfluenceKernels] =
+{
+	"scalar", "sse2", "avx2"
+};
+
+LocalInfluenceKernel SumLocalInfluence = SumLocalInfluenceScalar;
+
+static void BuildLocalInfluenceTables()
+{
+	// Any densities work here as long as they compare the right way
+	static const uint8_t otherDensities[Num_DensityComparisons] = { 7, 8, 9 };
+	const uint8_t populationDensity = 8;
+
+	memset(LocalInfluenceTables, 0, sizeof(LocalInfluenceTables));
+
+	for (uint8_t type = 0; type < INFLUENCE_TABLE_SIZE; type++)
+	{
+		LocalInfluenceTable* table = &LocalInfluenceTables[type];
+
+		for (uint8_t otherType = 0; otherType < INFLUENCE_TABLE_SIZE; otherType++)
+		{
+			bool hasInfluence = false;
+
+			for (uint8_t comparison = 0; comparison < Num_DensityComparisons; comparison++)
+			{
+				// The kernels add the influences up as unsigned bytes
+				int8_t influence = GetLocalInfluence(type, populationDensity, otherType, otherDensities[comparison]);
+				table->influence[comparison][otherType] = influence > 0 ? influence : 0;
+				hasInfluence |= influence > 0;
+			}
+
+			if (hasInfluence)
+			{
+				table->otherTypes[table->numOtherTypes++] = otherType;
+			}
+		}
+	}
+}
+
+bool IsInfluenceKernelSupported(uint8_t kernel)
+{
+	switch (kernel)
+	{
+	case InfluenceKernel_Scalar:
+		return true;
+#ifdef USE_X86_INFLUENCE_KERNELS
+	case InfluenceKernel_SSE2:
+		return CPUSupportsSSE2();
+	case InfluenceKernel_AVX2:
+		return CPUSupportsAVX2();
+#endif
+	default:
+		return false;
+	}
+}
+
+static bool SetUpInfluenceKernels()
+{
+	BuildLocalInfluenceTables();
+
+	if (!InfluenceKernelForced)
+	{
+		SelectedInfluenceKernel = InfluenceKernel_Scalar;
+		for (uint8_t kernel = InfluenceKernel_Scalar + 1; kernel < Num_InfluenceKernels; kernel++)
+		{
+			if (IsInfluenceKernelSupported(kernel))
+				SelectedInfluenceKernel = kernel;
+		}
+	}
+
+	SumLocalInfluence = InfluenceKernels[SelectedInfluenceKernel];
+	return true;
+}
+
+void InitInfluenceKernels()
+{
+	// The tables are the same for every city, so they are set up once by whichever thread gets here first
+	static bool initialised = SetUpInfluenceKernels();
+	(void)initialised;
+}
+
+bool SetInfluenceKernel(uint8_t kernel)
+{
+	if (!IsInfluenceKernelSupported(kernel))
+		return false;
+
+	InitInfluenceKernels();
+	InfluenceKernelForced = true;
+	SelectedInfluenceKernel = kernel;
+	SumLocalInfluence = InfluenceKernels[kernel];
+	return true;
+}
+
+uint8_t GetInfluenceKernel()
+{
+	return SelectedInfluenceKernel;
+}
+
+const char* GetInfluenceKernelName(uint8_t kernel)
+{
+	return kernel < Num_InfluenceKernels ? InfluenceKernelNames[kernel] : "unknown";
+}
+
+uint8_t FindInfluenceKernel(const char* name)
+{
+	uint8_t kernel = 0;
+	while (kernel < Num_InfluenceKernels && strcmp(name, InfluenceKernelNames[kernel]))
+		kernel++;
+	return kernel;
+}
+
+#endif
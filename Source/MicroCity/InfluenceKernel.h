@@ -0,0 +1,55 @@
+#pragma once
+
+#include "BuildingIndex.h"
+
+#ifdef USE_BUILDING_INDEX
+
+// Adds up the local influence on a building from the other buildings in a span of City.indexedBuildings.
+// Desktop builds on x86 have SSE2 and AVX2 versions working on 16 or 32 entries at a time, chosen
+// when the simulation caches are reset from what the CPU supports. They all give the same result
+
+enum InfluenceKernelType
+{
+	InfluenceKernel_Scalar,
+	InfluenceKernel_SSE2,
+	InfluenceKernel_AVX2,
+	Num_InfluenceKernels
+};
+
+typedef struct
+{
+	uint8_t x;
+	uint8_t y;
+	uint8_t radius;
+	uint8_t slot;		// The building's own entry is skipped
+	uint8_t type;
+	uint8_t populationDensity;
+} LocalInfluenceQuery;
+
+typedef int16_t (*LocalInfluenceKernel)(const LocalInfluenceQuery* query, uint8_t start, uint8_t end);
+
+// Entries between start and end which are further away than query->radius are skipped
+extern LocalInfluenceKernel SumLocalInfluence;
+
+// Builds the lookup tables for the vector kernels and picks one, unless one has been forced. Only does
+// anything the first time it is called
+void InitInfluenceKernels(void);
+
+// For benchmarks and tests. Returns false if the CPU can't run the kernel
+bool SetInfluenceKernel(uint8_t kernel);
+bool IsInfluenceKernelSupported(uint8_t kernel);
+uint8_t GetInfluenceKernel(void);
+const char* GetInfluenceKernelName(uint8_t kernel);
+uint8_t FindInfluenceKernel(const char* name);		// Num_InfluenceKernels if there isn't one called name
+
+inline void BeginLocalInfluence(LocalInfluenceQuery* query, Building* building, uint8_t radius)
+{
+	query->x = building->x;
+	query->y = building->y;
+	query->radius = radius;
+	query->slot = building - City.state.buildings;
+	query->type = building->type;
+	query->populationDensity = building->populationDensity;
+}
+
+#endif
@@ -1,31 +1,29 @@
 #include "Game.h"
+#include "City.h"
 #include "Interface.h"
 #include "Draw.h"
-
-UIStateStruct UIState;
-
-static uint8_t LastInput = 0;
-static uint8_t InputRepeatCounter = 0;
+#include "Simulation.h"
+#include "Trace.h"
 
 void UpdateInterface()
 {
 	// Scroll screen to center the selected tile
-	int targetX = UIState.selectX * 8 + TILE_SIZE / 2 - DISPLAY_WIDTH / 2;
-	int targetY = UIState.selectY * 8 + TILE_SIZE / 2 - DISPLAY_HEIGHT / 2;
+	int targetX = City.uiState.selectX * 8 + TILE_SIZE / 2 - DISPLAY_WIDTH / 2;
+	int targetY = City.uiState.selectY * 8 + TILE_SIZE / 2 - DISPLAY_HEIGHT / 2;
 
-	int diffX = targetX - UIState.scrollX;
-	UIState.scrollX = targetX - (diffX / 2);
-	int diffY = targetY - UIState.scrollY;
-	UIState.scrollY = targetY - (diffY / 2);
+	int diffX = targetX - City.uiState.scrollX;
+	City.uiState.scrollX = targetX - (diffX / 2);
+	int diffY = targetY - City.uiState.scrollY;
+	City.uiState.scrollY = targetY - (diffY / 2);
 
-	/*if(UIState.scrollX < targetX)
-	UIState.scrollX ++;
-	else if(UIState.scrollX > targetX)
-	UIState.scrollX --;
-	if(UIState.scrollY < targetY)
-	UIState.scrollY++;
-	else if(UIState.scrollY > targetY)
-	UIState.scrollY --;*/
+	/*if(City.uiState.scrollX < targetX)
+	City.uiState.scrollX ++;
+	else if(City.uiState.scrollX > targetX)
+	City.uiState.scrollX --;
+	if(City.uiState.scrollY < targetY)
+	City.uiState.scrollY++;
+	else if(City.uiState.scrollY > targetY)
+	City.uiState.scrollY --;*/
 }
 
 void GetBuildingBrushLocation(BuildingType buildingType, uint8_t* outX, uint8_t* outY)
@@ -34,15 +32,15 @@ void GetBuildingBrushLocation(BuildingType buildingType, uint8_t* outX, uint8_t*
 	uint8_t width = pgm_read_byte(&buildingInfo->width);
 	uint8_t height = pgm_read_byte(&buildingInfo->height);
 
-	if (UIState.selectX > 0)
+	if (City.uiState.selectX > 0)
 	{
-		if (UIState.selectX - 1 > MAP_WIDTH - width)
+		if (City.uiState.selectX - 1 > MAP_WIDTH - width)
 		{
 			*outX = MAP_WIDTH - width;
 		}
 		else
 		{
-			*outX = UIState.selectX - 1;
+			*outX = City.uiState.selectX - 1;
 		}
 	}
 	else
@@ -50,15 +48,15 @@ void GetBuildingBrushLocation(BuildingType buildingType, uint8_t* outX, uint8_t*
 		*outX = 0;
 	}
 
-	if (UIState.selectY > 0)
+	if (City.uiState.selectY > 0)
 	{
-		if (UIState.selectY - 1 > MAP_HEIGHT - height)
+		if (City.uiState.selectY - 1 > MAP_HEIGHT - height)
 		{
 			*outY = MAP_HEIGHT - height;
 		}
 		else
 		{
-			*outY = UIState.selectY - 1;
+			*outY = City.uiState.selectY - 1;
 		}
 	}
 	else
@@ -71,174 +69,175 @@ void WrapMenuInput(uint8_t input, uint8_t numOptions)
 {
 	if (input & INPUT_UP)
 	{
-		if (UIState.selection > 0)
-			UIState.selection--;
-		else UIState.selection = numOptions - 1;
+		if (City.uiState.selection > 0)
+			City.uiState.selection--;
+		else City.uiState.selection = numOptions - 1;
 	}
 	if (input & INPUT_DOWN)
 	{
-		if (UIState.selection == numOptions - 1)
-			UIState.selection = 0;
-		else UIState.selection++;
+		if (City.uiState.selection == numOptions - 1)
+			City.uiState.selection = 0;
+		else City.uiState.selection++;
 	}
 }
 
 void HandleMovementInput(uint8_t input)
 {
-	if ((input & INPUT_LEFT) && UIState.selectX > 0)
+	if ((input & INPUT_LEFT) && City.uiState.selectX > 0)
 	{
-		UIState.selectX--;
+		City.uiState.selectX--;
 	}
-	if ((input & INPUT_UP) && UIState.selectY > 0)
+	if ((input & INPUT_UP) && City.uiState.selectY > 0)
 	{
-		UIState.selectY--;
+		City.uiState.selectY--;
 	}
-	if ((input & INPUT_RIGHT) && UIState.selectX < MAP_WIDTH - 1)
+	if ((input & INPUT_RIGHT) && City.uiState.selectX < MAP_WIDTH - 1)
 	{
-		UIState.selectX++;
+		City.uiState.selectX++;
 	}
-	if ((input & INPUT_DOWN) && UIState.selectY < MAP_HEIGHT - 1)
+	if ((input & INPUT_DOWN) && City.uiState.selectY < MAP_HEIGHT - 1)
 	{
-		UIState.selectY++;
+		City.uiState.selectY++;
 	}
 }
 
 void HandleInput(uint8_t input)
 {
-	if (UIState.state == ShowingToolbar)
+	if (City.uiState.state == ShowingToolbar)
 	{
 		if (input & INPUT_LEFT)
 		{
-			if (UIState.selection == 0)
+			if (City.uiState.selection == 0)
 			{
-				UIState.selection = NUM_TOOLBAR_BUTTONS - 1;
+				City.uiState.selection = NUM_TOOLBAR_BUTTONS - 1;
 			}
-			else UIState.selection--;
+			else City.uiState.selection--;
 		}
 		if (input & INPUT_RIGHT)
 		{
-			if (UIState.selection == NUM_TOOLBAR_BUTTONS - 1)
+			if (City.uiState.selection == NUM_TOOLBAR_BUTTONS - 1)
 			{
-				UIState.selection = 0;
+				City.uiState.selection = 0;
 			}
-			else UIState.selection++;
+			else City.uiState.selection++;
 		}
 		if (input & (INPUT_A | INPUT_B))
 		{
-			if (UIState.selection <= LastBuildingBrush)
+			if (City.uiState.selection <= LastBuildingBrush)
 			{
-				UIState.brush = UIState.selection;
-				UIState.state = InGame;
+				City.uiState.brush = City.uiState.selection;
+				City.uiState.state = InGame;
 			}
-			else if (UIState.selection == SaveLoadToolbarButton)
+			else if (City.uiState.selection == SaveLoadToolbarButton)
 			{
-				UIState.state = SaveLoadMenu;
-				UIState.selection = 0;
+				City.uiState.state = SaveLoadMenu;
+				City.uiState.selection = 0;
 			}
-			else if (UIState.selection == BudgetToolbarButton)
+			else if (City.uiState.selection == BudgetToolbarButton)
 			{
-				UIState.state = BudgetMenu;
-				UIState.selection = MIN_BUDGET_DISPLAY_TIME;
+				City.uiState.state = BudgetMenu;
+				City.uiState.selection = MIN_BUDGET_DISPLAY_TIME;
 			}
 		}
 	}
-	else if (UIState.state == InGameDisaster)
+	else if (City.uiState.state == InGameDisaster)
 	{
 		HandleMovementInput(input);
 	}
-	else if (UIState.state == StartScreen)
+	else if (City.uiState.state == StartScreen)
 	{
 		WrapMenuInput(input, 2);
 		if (input & (INPUT_B))
 		{
-			switch (UIState.selection)
+			switch (City.uiState.selection)
 			{
 			case 0:
-				UIState.state = NewCityMenu;
+				City.uiState.state = NewCityMenu;
 				break;
 			case 1:
 				if (LoadCity())
 				{
-					UIState.state = InGame;
+					City.uiState.state = InGame;
+					ResetSimulationCaches();
 					ResetVisibleTileCache();
 				}
 				break;
 			}
 		}
 	}
-	else if (UIState.state == NewCityMenu)
+	else if (City.uiState.state == NewCityMenu)
 	{
 		if (input & INPUT_LEFT)
 		{
-			if (State.terrainType == 0)
+			if (City.state.terrainType == 0)
 			{
-				State.terrainType = NUM_TERRAIN_TYPES - 1;
+				City.state.terrainType = NUM_TERRAIN_TYPES - 1;
 			}
-			else State.terrainType--;
+			else City.state.terrainType--;
 		}
 		if (input & INPUT_RIGHT)
 		{
-			if (State.terrainType == NUM_TERRAIN_TYPES - 1)
+			if (City.state.terrainType == NUM_TERRAIN_TYPES - 1)
 			{
-				State.terrainType = 0;
+				City.state.terrainType = 0;
 			}
-			else State.terrainType++;
+			else City.state.terrainType++;
 		}
 		if (input & (INPUT_B))
 		{
-			uint8_t terrainType = State.terrainType;
+			uint8_t terrainType = City.state.terrainType;
 			InitGame();
-			State.terrainType = terrainType;
-			ResetVisibleTileCache();
-			UIState.state = InGame;
+			SetTerrainType(terrainType);
+			City.uiState.state = InGame;
 		}
 	}
-	else if (UIState.state == SaveLoadMenu)
+	else if (City.uiState.state == SaveLoadMenu)
 	{
 		WrapMenuInput(input, 4);
 		if (input & (INPUT_A))
 		{
-			UIState.state = InGame;
+			City.uiState.state = InGame;
 		}
 		if (input & INPUT_B)
 		{
-			switch (UIState.selection)
+			switch (City.uiState.selection)
 			{
 			case 0:
 				SaveCity();
-				UIState.state = InGame;
+				City.uiState.state = InGame;
 				break;
 			case 1:
 				if (LoadCity())
 				{
-					UIState.state = InGame;
+					City.uiState.state = InGame;
+					ResetSimulationCaches();
 					ResetVisibleTileCache();
 				}
 				break;
 			case 2:
-				UIState.state = NewCityMenu;
+				City.uiState.state = NewCityMenu;
 				break;
 			case 3:
-				UIState.autoBudget = !UIState.autoBudget;
+				City.uiState.autoBudget = !City.uiState.autoBudget;
 				break;
 			}
 		}
 	}
-	else if (UIState.state == InGame)
+	else if (City.uiState.state == InGame)
 	{
 		HandleMovementInput(input);
 
 		if (input & INPUT_A)
 		{
-			UIState.state = ShowingToolbar;
-			UIState.selection = UIState.brush;
+			City.uiState.state = ShowingToolbar;
+			City.uiState.selection = City.uiState.brush;
 		}
 
 		if (input & INPUT_B)
 		{
-			if (UIState.brush == Bulldozer)
+			if (City.uiState.brush == Bulldozer)
 			{
-				Building* building = GetBuilding(UIState.selectX, UIState.selectY);
+				Building* building = GetBuilding(City.uiState.selectX, City.uiState.selectY);
 				if (building && !IsRubble(building->type))
 				{
 					const BuildingInfo* buildingInfo = GetBuildingInfo(building->type);
@@ -246,9 +245,9 @@ void HandleInput(uint8_t input)
 					uint8_t height = pgm_read_byte(&buildingInfo->height);
 					int cost = width * height * BULLDOZER_COST;
 
-					if (State.money >= cost)
+					if (City.state.money >= cost)
 					{
-						State.money -= cost;
+						City.state.money -= cost;
 
 						DestroyBuilding(building);
 					}
@@ -259,15 +258,15 @@ void HandleInput(uint8_t input)
 				}
 				else
 				{
-					if (GetConnections(UIState.selectX, UIState.selectY))
+					if (GetConnections(City.uiState.selectX, City.uiState.selectY))
 					{
-						if (State.money >= BULLDOZER_COST)
+						if (City.state.money >= BULLDOZER_COST)
 						{
-							State.money -= BULLDOZER_COST;
+							City.state.money -= BULLDOZER_COST;
 
-							SetConnections(UIState.selectX, UIState.selectY, 0);
-							RefreshTileAndConnectedNeighbours(UIState.selectX, UIState.selectY);
-							SetTile(UIState.selectX, UIState.selectY, RUBBLE_TILE);
+							SetConnections(City.uiState.selectX, City.uiState.selectY, 0);
+							RefreshTileAndConnectedNeighbours(City.uiState.selectX, City.uiState.selectY);
+							SetTile(City.uiState.selectX, City.uiState.selectY, RUBBLE_TILE);
 						}
 						else
 						{
@@ -280,38 +279,40 @@ void HandleInput(uint8_t input)
 					}
 				}
 			}
-			else if (UIState.brush < FirstBuildingBrush)
+			else if (City.uiState.brush < FirstBuildingBrush)
 			{
 				// Is powerline or road
 
-				Building* building = GetBuilding(UIState.selectX, UIState.selectY);
+				Building* building = GetBuilding(City.uiState.selectX, City.uiState.selectY);
 				if (building && !IsRubble(building->type))
 				{
 					// TODO: can't build here
 				}
 				else
 				{
-					int cost = UIState.brush == RoadBrush ? ROAD_COST : POWERLINE_COST;
-					uint8_t mask = UIState.brush == RoadBrush ? RoadMask : PowerlineMask;
-					uint8_t currentConnections = GetConnections(UIState.selectX, UIState.selectY);
-					bool onGround =  IsTerrainClear(UIState.selectX, UIState.selectY);
+					int cost = City.uiState.brush == RoadBrush ? ROAD_COST : POWERLINE_COST;
+					uint8_t mask = City.uiState.brush == RoadBrush ? RoadMask : PowerlineMask;
+					uint8_t currentConnections = GetConnections(City.uiState.selectX, City.uiState.selectY);
+					bool onGround =  IsTerrainClear(City.uiState.selectX, City.uiState.selectY);
 					
-					if(onGround || (currentConnections == 0 && IsSuitableForBridgedTile(UIState.selectX, UIState.selectY, mask)))
+					if(onGround || (currentConnections == 0 && IsSuitableForBridgedTile(City.uiState.selectX, City.uiState.selectY, mask)))
 					{
 						if ((currentConnections & mask) == 0)
 						{
-							if (State.money >= cost)
+							if (City.state.money >= cost)
 							{
-								State.money -= cost;
-								SetConnections(UIState.selectX, UIState.selectY, currentConnections | mask);
+								City.state.money -= cost;
+								SetConnections(City.uiState.selectX, City.uiState.selectY, currentConnections | mask);
 
 								// Remove rubble
 								if (building)
 								{
 									building->type = 0;
+									building->onFire = 0;
+									UpdateBuildingCaches(building);
 								}
 
-								RefreshTileAndConnectedNeighbours(UIState.selectX, UIState.selectY);
+								RefreshTileAndConnectedNeighbours(City.uiState.selectX, City.uiState.selectY);
 							}
 							else
 							{
@@ -324,7 +325,7 @@ void HandleInput(uint8_t input)
 			else
 			{
 				// Is building placement
-				BuildingType buildingType = (BuildingType)(UIState.brush - FirstBuildingBrush + 1);
+				BuildingType buildingType = (BuildingType)(City.uiState.brush - FirstBuildingBrush + 1);
 				const BuildingInfo* buildingInfo = GetBuildingInfo(buildingType);
 				uint8_t placeX, placeY;
 				GetBuildingBrushLocation(buildingType, &placeX, &placeY);
@@ -332,11 +333,11 @@ void HandleInput(uint8_t input)
 
 				if (CanPlaceBuilding(buildingType, placeX, placeY))
 				{
-					if (State.money >= cost)
+					if (City.state.money >= cost)
 					{
 						if (PlaceBuilding(buildingType, placeX, placeY))
 						{
-							State.money -= cost;
+							City.state.money -= cost;
 						}
 						else
 						{
@@ -355,36 +356,43 @@ void HandleInput(uint8_t input)
 			}
 		}
 	}
-	else if (UIState.state == BudgetMenu)
+	else if (City.uiState.state == BudgetMenu)
 	{
 		// Display for a minimum of a few frames to prevent closing the budget menu by accident
-		if (UIState.selection >= MIN_BUDGET_DISPLAY_TIME)
+		if (City.uiState.selection >= MIN_BUDGET_DISPLAY_TIME)
 		{
-			if ((input & INPUT_LEFT) && State.taxRate > 0)
+			if ((input & INPUT_LEFT) && City.state.taxRate > 0)
 			{
-				State.taxRate--;
+				City.state.taxRate--;
 			}
-			if ((input & INPUT_RIGHT) && State.taxRate < 99)
+			if ((input & INPUT_RIGHT) && City.state.taxRate < 99)
 			{
-				State.taxRate++;
+				City.state.taxRate++;
 			}
 			if (input & (INPUT_A | INPUT_B))
 			{
-				UIState.state = InGame;
+				City.uiState.state = InGame;
 			}
 		}
 	}
 }
 
+void ResetInputState()
+{
+	City.lastInput = 0;
+	City.inputRepeatCounter = 0;
+}
+
 void ProcessInput()
 {
+	TRACE_ZONE("ProcessInput");
 	uint8_t input = GetInput();
 
-	if (input != LastInput)
+	if (input != City.lastInput)
 	{
-		InputRepeatCounter = 0;
+		City.inputRepeatCounter = 0;
 
-		uint8_t newInput = (LastInput ^ input) & input;
+		uint8_t newInput = (City.lastInput ^ input) & input;
 
 		if (newInput)
 		{
@@ -393,13 +401,13 @@ void ProcessInput()
 	}
 	else
 	{
-		InputRepeatCounter++;
-		if (InputRepeatCounter > INPUT_REPEAT_TIME)
+		City.inputRepeatCounter++;
+		if (City.inputRepeatCounter > INPUT_REPEAT_TIME)
 		{
-			HandleInput(LastInput);
-			InputRepeatCounter -= INPUT_REPEAT_FREQUENCY;
+			HandleInput(City.lastInput);
+			City.inputRepeatCounter -= INPUT_REPEAT_FREQUENCY;
 		}
 	}
 
-	LastInput = input;
+	City.lastInput = input;
 }
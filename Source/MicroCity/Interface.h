@@ -46,11 +46,10 @@ typedef struct
 	bool autoBudget : 1;
 } UIStateStruct;
 
-extern UIStateStruct UIState;
-
 uint8_t GetInput();
 
 void ProcessInput(void);
+void ResetInputState(void);
 void UpdateInterface(void);
 
 void GetBuildingBrushLocation(BuildingType buildingType, uint8_t* outX, uint8_t* outY);
@@ -0,0 +1,127 @@
+#include "City.h"
+#include "Building.h"
+#include "LandValue.h"
+#include "Simulation.h"
+#include "Terrain.h"
+#include "Trace.h"
+
+#ifdef USE_LAND_VALUE
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2_LAND_VALUE
+#include <emmintrin.h>
+
+static_assert(MAP_WIDTH % 8 == 0, "Rows are summed eight tiles at a time");
+#endif
+
+// Adds (or with sign -1 takes away) one row of tiles from another
+static inline void AddRow(int16_t* sum, const int16_t* row, int sign)
+{
+#ifdef USE_SSE2_LAND_VALUE
+	for (int x = 0; x < MAP_WIDTH; x += 8)
+	{
+		__m128i total = _mm_loadu_si128((const __m128i*)&sum[x]);
+		__m128i tiles = _mm_loadu_si128((const __m128i*)&row[x]);
+		total = sign > 0 ? _mm_add_epi16(total, tiles) : _mm_sub_epi16(total, tiles);
+		_mm_storeu_si128((__m128i*)&sum[x], total);
+	}
+#else
+	for (int x = 0; x < MAP_WIDTH; x++)
+	{
+		sum[x] += sign * row[x];
+	}
+#endif
+}
+
+// Sums the square of tiles reaching radius tiles out from each tile, cut off at the edges of the map. Being
+// a square it reaches further along the diagonals than the diamond the building queries cover
+static void SumSquares(const int16_t* tiles, int16_t* sums, int radius)
+{
+	int16_t rowSums[MAP_WIDTH * MAP_HEIGHT];
+
+	// Along each row, adding the tile coming into the square and taking away the one leaving it
+	for (int y = 0; y < MAP_HEIGHT; y++)
+	{
+		const int16_t* row = &tiles[y * MAP_WIDTH];
+		int16_t sum = 0;
+
+		for (int x = 0; x < radius && x < MAP_WIDTH; x++)
+		{
+			sum += row[x];
+		}
+
+		for (int x = 0; x < MAP_WIDTH; x++)
+		{
+			if (x + radius < MAP_WIDTH)
+				sum += row[x + radius];
+			if (x - radius - 1 >= 0)
+				sum -= row[x - radius - 1];
+			rowSums[y * MAP_WIDTH + x] = sum;
+		}
+	}
+
+	// Then down the columns, a whole row at a time
+	int16_t sum[MAP_WIDTH] = { 0 };
+
+	for (int y = 0; y < radius && y < MAP_HEIGHT; y++)
+	{
+		AddRow(sum, &rowSums[y * MAP_WIDTH], 1);
+	}
+
+	for (int y = 0; y < MAP_HEIGHT; y++)
+	{
+		if (y + radius < MAP_HEIGHT)
+			AddRow(sum, &rowSums[(y + radius) * MAP_WIDTH], 1);
+		if (y - radius - 1 >= 0)
+			AddRow(sum, &rowSums[(y - radius - 1) * MAP_WIDTH], -1);
+		memcpy(&sums[y * MAP_WIDTH], sum, sizeof(sum));
+	}
+}
+
+void UpdateLandValue()
+{
+	TRACE_ZONE("UpdateLandValue");
+	int16_t parks[MAP_WIDTH * MAP_HEIGHT];
+	int16_t water[MAP_WIDTH * MAP_HEIGHT];
+
+	// Parks only count when people can get to them
+	memset(parks, 0, sizeof(parks));
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type == Park && IsRoadConnected(building))
+		{
+			parks[building->y * MAP_WIDTH + building->x]++;
+		}
+	}
+
+	for (int y = 0; y < MAP_HEIGHT; y++)
+	{
+		for (int x = 0; x < MAP_WIDTH; x++)
+		{
+			water[y * MAP_WIDTH + x] = IsTerrainClear(x, y) ? 0 : 1;
+		}
+	}
+
+	SumSquares(parks, parks, LAND_VALUE_PARK_DISTANCE);
+	SumSquares(water, water, LAND_VALUE_WATER_DISTANCE);
+
+	for (int n = 0; n < MAP_WIDTH * MAP_HEIGHT; n++)
+	{
+		int waterBoost = water[n] * LAND_VALUE_WATER_BOOST;
+
+		if (waterBoost > LAND_VALUE_MAX_WATER_BOOST)
+			waterBoost = LAND_VALUE_MAX_WATER_BOOST;
+
+		City.landValue[n] = parks[n] * SIM_PARK_BOOST + waterBoost;
+	}
+}
+
+int16_t GetLandValue(uint8_t x, uint8_t y)
+{
+	return City.landValue[y * MAP_WIDTH + x];
+}
+
+#endif
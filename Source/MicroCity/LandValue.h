@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Game.h"
+
+#define SIM_PARK_BOOST 5
+#define SIM_POLLUTION_INFLUENCE 2
+#define SIM_MAX_POLLUTION 50
+
+#ifdef USE_LAND_VALUE
+
+// Parks count as far as the influence from other buildings reaches, water only when it is close by
+#define LAND_VALUE_PARK_DISTANCE 32
+#define LAND_VALUE_WATER_DISTANCE 3
+#define LAND_VALUE_WATER_BOOST 1
+#define LAND_VALUE_MAX_WATER_BOOST 10
+
+// Land value builds work out how much a home is worth at every tile once a month, from the parks nearby and
+// being close to water. Parks and water are counted over a square around each tile with two running sums,
+// along the rows and then down the columns, so it costs the same however many buildings there are. The
+// square takes in parks out to the corners, a little further than the diamond of LAND_VALUE_PARK_DISTANCE
+// the Arduboy counts over. Residential zones look up their tile instead of counting the parks themselves,
+// pollution is still taken from their neighbours so a home isn't marked down for its own traffic
+void UpdateLandValue(void);
+
+int16_t GetLandValue(uint8_t x, uint8_t y);
+
+#else
+
+inline void UpdateLandValue() {}
+
+#endif
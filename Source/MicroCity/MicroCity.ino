@@ -3,6 +3,7 @@
 #include "Draw.h"
 #include "Interface.h"
 #include "Game.h"
+#include "City.h"
 #include "Simulation.h"
 
 Arduboy2Base arduboy;
@@ -71,7 +72,7 @@ void SaveCity()
   EEPROM.update(address++, 'Y'); 
   EEPROM.update(address++, '1'); 
 
-  uint8_t* ptr = (uint8_t*) &State;
+  uint8_t* ptr = (uint8_t*) &City.state;
   for(size_t n = 0; n < sizeof(GameState); n++)
   {
     EEPROM.update(address++, *ptr);
@@ -88,7 +89,7 @@ bool LoadCity()
   if(EEPROM.read(address++) != 'Y') return false;
   if(EEPROM.read(address++) != '1') return false;
 
-  uint8_t* ptr = (uint8_t*) &State;
+  uint8_t* ptr = (uint8_t*) &City.state;
   for(size_t n = 0; n < sizeof(GameState); n++)
   {
     *ptr = EEPROM.read(address++);
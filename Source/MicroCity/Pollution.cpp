@@ -0,0 +1,70 @@
+#include "City.h"
+#include "Pollution.h"
+
+#ifdef USE_POLLUTION_FIELD
+
+// Adds (or with sign -1 removes) a diamond of pollution centred on (x, y)
+static void StampPollution(uint8_t x, uint8_t y, uint8_t strength, int sign)
+{
+	int y1 = y - strength + 1 < 0 ? 0 : y - strength + 1;
+	int y2 = y + strength - 1 >= MAP_HEIGHT ? MAP_HEIGHT - 1 : y + strength - 1;
+
+	for (int j = y1; j <= y2; j++)
+	{
+		int rowStrength = strength - (j > y ? j - y : y - j);
+		int x1 = x - rowStrength + 1 < 0 ? 0 : x - rowStrength + 1;
+		int x2 = x + rowStrength - 1 >= MAP_WIDTH ? MAP_WIDTH - 1 : x + rowStrength - 1;
+		int16_t* row = &City.pollutionField[j * MAP_WIDTH];
+
+		for (int i = x1; i <= x2; i++)
+		{
+			row[i] += sign * (rowStrength - (i > x ? i - x : x - i));
+		}
+	}
+}
+
+void UpdateBuildingPollution(Building* building)
+{
+	PollutionStamp* stamp = &City.pollutionStamps[building - City.state.buildings];
+	uint8_t strength = GetPollutionStrength(building);
+
+	if (stamp->strength == strength && (strength == 0 || (stamp->x == building->x && stamp->y == building->y)))
+		return;
+
+	if (stamp->strength)
+	{
+		StampPollution(stamp->x, stamp->y, stamp->strength, -1);
+	}
+
+	stamp->x = building->x;
+	stamp->y = building->y;
+	stamp->strength = strength;
+
+	if (strength)
+	{
+		StampPollution(stamp->x, stamp->y, strength, 1);
+	}
+}
+
+void ResetPollution()
+{
+	memset(City.pollutionField, 0, sizeof(City.pollutionField));
+	memset(City.pollutionStamps, 0, sizeof(City.pollutionStamps));
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		UpdateBuildingPollution(&City.state.buildings[n]);
+	}
+}
+
+int16_t GetPollution(uint8_t x, uint8_t y)
+{
+	return City.pollutionField[y * MAP_WIDTH + x];
+}
+
+int16_t GetPollutionFromNeighbours(Building* building)
+{
+	return GetPollution(building->x, building->y) - City.pollutionStamps[building - City.state.buildings].strength;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Game.h"
+
+#define SIM_INDUSTRIAL_BASE_POLLUTION 8
+#define SIM_TRAFFIC_BASE_POLLUTION 8
+#define SIM_POWERPLANT_BASE_POLLUTION 32
+
+// How much pollution a building gives off at its own position, falling off by one per tile of
+// Manhattan distance. Only buildings which are running (powered and not on fire) pollute
+inline uint8_t GetPollutionStrength(Building* building)
+{
+	if (!building->type || !(building->hasPower || building->type == Park) || building->onFire)
+		return 0;
+
+	if (building->type == Industrial)
+		return SIM_INDUSTRIAL_BASE_POLLUTION + building->populationDensity;
+	if (building->type == Powerplant)
+		return SIM_POWERPLANT_BASE_POLLUTION;
+	if (building->heavyTraffic)
+		return SIM_TRAFFIC_BASE_POLLUTION;
+	return 0;
+}
+
+#ifdef USE_POLLUTION_FIELD
+
+// Desktop builds keep the total pollution at every tile up to date as buildings change, so a building
+// can look up its pollution instead of adding up every source. UpdateBuildingPollution must be called
+// whenever anything GetPollutionStrength depends on changes
+void UpdateBuildingPollution(Building* building);
+void ResetPollution(void);
+
+// Total pollution at a tile from every building
+int16_t GetPollution(uint8_t x, uint8_t y);
+
+// Pollution at a building's position from all the other buildings
+int16_t GetPollutionFromNeighbours(Building* building);
+
+#else
+
+inline void UpdateBuildingPollution(Building* building) {}
+inline void ResetPollution() {}
+
+#endif
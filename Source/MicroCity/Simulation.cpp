@@ -1,8 +1,22 @@
 #include "Game.h"
+#include "City.h"
 #include "Connectivity.h"
 #include "Draw.h"
 #include "Interface.h"
 #include "Simulation.h"
+#include "BuildingIndex.h"
+#include "InfluenceKernel.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#if defined(USE_FAST_FORWARD) || defined(USE_SIMULATION_SCHEDULER)
+#include <chrono>
+#endif
+
+#ifdef ENABLE_CHECKS
+#include <stdio.h>
+#include <stdlib.h>
+#endif
 
 enum SimulationSteps
 {
@@ -12,7 +26,7 @@ enum SimulationSteps
 	SimulateNextMonth
 };
 
-#ifdef _WIN32
+#if defined(_WIN32) && !defined(MICROCITY_HEADLESS)
 void DebugBuildingScore(Building* building, int score, int crime, int pollution, int localInfluence, int populationEffect, int randomEffect);
 #else
 inline void DebugBuildingScore(Building* building, int score, int crime, int pollution, int localInfluence, int populationEffect, int randomEffect) {}
@@ -31,14 +45,8 @@ inline void DebugBuildingScore(Building* building, int score, int crime, int pol
 #define SIM_LOCAL_BUILDING_DISTANCE 32
 #define SIM_LOCAL_BUILDING_INFLUENCE 4
 #define SIM_STADIUM_BOOST 100
-#define SIM_PARK_BOOST 5
 #define SIM_MAX_CRIME 50
 #define SIM_RANDOM_STRENGTH_MASK 31
-#define SIM_POLLUTION_INFLUENCE 2
-#define SIM_MAX_POLLUTION 50
-#define SIM_INDUSTRIAL_BASE_POLLUTION 8
-#define SIM_TRAFFIC_BASE_POLLUTION 8
-#define SIM_POWERPLANT_BASE_POLLUTION 32
 #define SIM_HEAVY_TRAFFIC_THRESHOLD 12
 #define SIM_IDEAL_TAX_RATE 6
 #define SIM_TAX_RATE_PENALTY 10
@@ -47,7 +55,12 @@ inline void DebugBuildingScore(Building* building, int score, int crime, int pol
 #define SIM_FIRE_DEPT_BASE_INFLUENCE 64				// Higher means less influence
 #define SIM_FIRE_DEPT_INFLUENCE_MULTIPLIER 5		// Higher means less influence (based on distance)
 
-uint8_t GetNumRoadConnections(Building* building)
+#ifdef USE_ROAD_CONNECTION_CACHE
+// Road counts are recounted when a road next to the building changes
+#define UNKNOWN_ROAD_CONNECTIONS 0xff
+#endif
+
+static uint8_t CountRoadConnections(Building* building)
 {
 	const BuildingInfo* info = GetBuildingInfo(building->type);
 	uint8_t width = pgm_read_byte(&info->width);
@@ -98,6 +111,69 @@ uint8_t GetNumRoadConnections(Building* building)
 	return count;
 }
 
+#ifdef USE_ROAD_CONNECTION_CACHE
+
+uint8_t GetNumRoadConnections(Building* building)
+{
+	uint8_t* count = &City.roadConnectionCounts[building - City.state.buildings];
+
+	if (*count == UNKNOWN_ROAD_CONNECTIONS)
+	{
+		*count = CountRoadConnections(building);
+	}
+
+	return *count;
+}
+
+void InvalidateRoadConnections(Building* building)
+{
+	City.roadConnectionCounts[building - City.state.buildings] = UNKNOWN_ROAD_CONNECTIONS;
+}
+
+void InvalidateRoadConnections(uint8_t x, uint8_t y)
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type)
+		{
+			const BuildingInfo* info = GetBuildingInfo(building->type);
+			uint8_t width = pgm_read_byte(&info->width);
+			uint8_t height = pgm_read_byte(&info->height);
+
+			// Only tiles sharing an edge with the footprint count, not the corners
+			if ((x >= building->x && x < building->x + width && (y + 1 == building->y || y == building->y + height))
+				|| (y >= building->y && y < building->y + height && (x + 1 == building->x || x == building->x + width)))
+			{
+				City.roadConnectionCounts[n] = UNKNOWN_ROAD_CONNECTIONS;
+				UpdateIndexedBuilding(building);
+			}
+		}
+	}
+}
+
+void ResetRoadConnections()
+{
+	memset(City.roadConnectionCounts, UNKNOWN_ROAD_CONNECTIONS, sizeof(City.roadConnectionCounts));
+	City.numRoadTiles = CountRoadTiles();
+}
+
+#else
+
+uint8_t GetNumRoadConnections(Building* building)
+{
+	return CountRoadConnections(building);
+}
+
+#endif
+
+// If at least 3 road tiles are adjacent then assume that it is connected to the road network
+bool IsRoadConnected(Building* building)
+{
+	return GetNumRoadConnections(building) >= 3;
+}
+
 uint8_t GetManhattanDistance(Building* a, Building* b)
 {
 	uint8_t x = a->x > b->x ? a->x - b->x : b->x - a->x;
@@ -107,66 +183,64 @@ uint8_t GetManhattanDistance(Building* a, Building* b)
 
 void DoBudget()
 {
+	TRACE_ZONE("DoBudget");
 	// Collect taxes
-	int32_t totalPopulation = (State.residentialPopulation + State.commercialPopulation + State.residentialPopulation) * POPULATION_MULTIPLIER;
-	State.taxesCollected = (totalPopulation * State.taxRate) / 100;
+	int32_t totalPopulation = (City.state.residentialPopulation + City.state.commercialPopulation + City.state.residentialPopulation) * POPULATION_MULTIPLIER;
+	City.state.taxesCollected = (totalPopulation * City.state.taxRate) / 100;
 
-	State.money += State.taxesCollected;
+	City.state.money += City.state.taxesCollected;
 
 	// Count police and fire departments for costing
+#ifdef USE_BUILDING_INDEX
+	uint8_t numPoliceDept = GetBuildingTypeTotals(PoliceDept)->count;
+	uint8_t numFireDept = GetBuildingTypeTotals(FireDept)->count;
+#else
 	uint8_t numPoliceDept = 0;
 	uint8_t numFireDept = 0;
 
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		if (State.buildings[n].type == PoliceDept)
+		if (City.state.buildings[n].type == PoliceDept)
 		{
 			numPoliceDept++;
 		}
-		else if (State.buildings[n].type == FireDept)
+		else if (City.state.buildings[n].type == FireDept)
 		{
 			numFireDept++;
 		}
 	}
+#endif
 
-	State.fireBudget = numFireDept;
-	State.policeBudget = numPoliceDept;
+	City.state.fireBudget = numFireDept;
+	City.state.policeBudget = numPoliceDept;
 
-	State.money -= FIRE_AND_POLICE_MAINTENANCE_COST * numFireDept;
-	State.money -= FIRE_AND_POLICE_MAINTENANCE_COST * numPoliceDept;
+	City.state.money -= FIRE_AND_POLICE_MAINTENANCE_COST * numFireDept;
+	City.state.money -= FIRE_AND_POLICE_MAINTENANCE_COST * numPoliceDept;
 
 	// Count road tiles for cost of road maintenance
-	int numRoadTiles = 0;
-	for (int y = 0; y < MAP_HEIGHT; y++)
-	{
-		for (int x = 0; x < MAP_WIDTH; x++)
-		{
-			if (GetConnections(x, y) & RoadMask)
-				numRoadTiles++;
-		}
-	}
+	int numRoadTiles = GetNumRoadTiles();
 
-	State.roadBudget = (numRoadTiles * ROAD_MAINTENANCE_COST) / 100;
-	State.money -= State.roadBudget;
+	City.state.roadBudget = (numRoadTiles * ROAD_MAINTENANCE_COST) / 100;
+	City.state.money -= City.state.roadBudget;
 
 #ifdef _WIN32
-	printf("Budget for %d:\n", State.year + 1899);
+	printf("Budget for %d:\n", City.state.year + 1899);
 	printf("Population: %d\n", totalPopulation);
-	printf("Taxes collected: $%d\n", State.taxesCollected);
+	printf("Taxes collected: $%d\n", City.state.taxesCollected);
 	printf("Police cost: %d x $%d = $%d\n", numPoliceDept, FIRE_AND_POLICE_MAINTENANCE_COST, FIRE_AND_POLICE_MAINTENANCE_COST * numPoliceDept);
 	printf("Fire cost: %d x $%d = $%d\n", numFireDept, FIRE_AND_POLICE_MAINTENANCE_COST, FIRE_AND_POLICE_MAINTENANCE_COST * numFireDept);
-	printf("Road maintenance: %d tiles = $%d\n", numRoadTiles, State.roadBudget);
+	printf("Road maintenance: %d tiles = $%d\n", numRoadTiles, City.state.roadBudget);
 #endif
 
-	int32_t cashFlow = State.taxesCollected - State.roadBudget - State.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST - State.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST;
-	if (!UIState.autoBudget || cashFlow <= 0 || State.money <= 0)
+	int32_t cashFlow = City.state.taxesCollected - City.state.roadBudget - City.state.policeBudget * FIRE_AND_POLICE_MAINTENANCE_COST - City.state.fireBudget * FIRE_AND_POLICE_MAINTENANCE_COST;
+	if (!City.uiState.autoBudget || cashFlow <= 0 || City.state.money <= 0)
 	{
-		UIState.state = BudgetMenu;
-		UIState.selection = 0;
+		City.uiState.state = BudgetMenu;
+		City.uiState.selection = 0;
 	}
 }
 
-bool SpreadFire(Building* building)
+bool SpreadFire(Building* building, uint8_t draw)
 {
 	const BuildingInfo* info = GetBuildingInfo(building->type);
 	uint8_t width = pgm_read_byte(&info->width);
@@ -175,7 +249,7 @@ bool SpreadFire(Building* building)
 	uint8_t y1 = building->y > 1 ? building->y - 2 : building->y;
 	uint8_t x2 = building->x + width + 2;
 	uint8_t y2 = building->y + height + 2;
-	uint8_t spreadDirection = GetRand() & 3;
+	uint8_t spreadDirection = GetSimulationRand(building - City.state.buildings, RandomPurpose_FireSpreadDirection, draw) & 3;
 
 	if (spreadDirection & 1)
 	{
@@ -183,9 +257,10 @@ bool SpreadFire(Building* building)
 		{
 			Building* neighbour = GetBuilding(spreadDirection & 2 ? x1 : x2, j);
 
-			if (neighbour && !neighbour->onFire && neighbour->type != Park && !IsRubble(neighbour->type))
+			if (neighbour && CanCatchFire(neighbour))
 			{
 				neighbour->onFire = 1;
+				UpdateBuildingCaches(neighbour);
 				RefreshBuildingTiles(neighbour);
 				return true;
 			}
@@ -197,9 +272,10 @@ bool SpreadFire(Building* building)
 		{
 			Building* neighbour = GetBuilding(i, spreadDirection & 2 ? y1 : y2);
 
-			if (neighbour && !neighbour->onFire && neighbour->type != Park && !IsRubble(neighbour->type))
+			if (neighbour && CanCatchFire(neighbour))
 			{
 				neighbour->onFire = 1;
+				UpdateBuildingCaches(neighbour);
 				RefreshBuildingTiles(neighbour);
 				return true;
 			}
@@ -209,240 +285,460 @@ bool SpreadFire(Building* building)
 	return false;
 }
 
-void SimulateBuilding(Building* building)
+// Effect on a zone from another building nearby
+int8_t GetLocalInfluence(uint8_t buildingType, uint8_t populationDensity, uint8_t otherType, uint8_t otherPopulationDensity)
 {
-	int8_t populationDensityChange = 0;
-
-	if (building->onFire)
+	switch(otherType)
 	{
-		if (IsRubble(building->type))
+		case Industrial:
+		if(otherPopulationDensity >= populationDensity && buildingType == Residential)
 		{
-			building->onFire--;
-			if ((GetRand() & 0xff) > SIM_FIRE_SPREAD_CHANCE)
-			{
-				SpreadFire(building);
-			}
-			RefreshBuildingTiles(building);
-			return;
+			return SIM_LOCAL_BUILDING_INFLUENCE;
 		}
-
-		// Find closest fire department
-		uint8_t closestFireDept = 0xff;
-
-		for (int n = 0; n < MAX_BUILDINGS; n++)
+		else if (otherPopulationDensity > populationDensity && buildingType == Commercial)
 		{
-			Building* otherBuilding = &State.buildings[n];
-
-			if (otherBuilding->type == FireDept && otherBuilding->hasPower)
-			{
-				uint8_t distance = GetManhattanDistance(building, otherBuilding);
-
-				if (distance < closestFireDept)
-				{
-					closestFireDept = distance;
-				}
-			}
+			return SIM_LOCAL_BUILDING_INFLUENCE;
 		}
-
-		int fireDeptInfluence = SIM_FIRE_DEPT_BASE_INFLUENCE + closestFireDept * SIM_FIRE_DEPT_INFLUENCE_MULTIPLIER;
-		
-		if (fireDeptInfluence <= 255 && (GetRand() & 0xff) > (uint8_t)(fireDeptInfluence))
+		break;
+		case Residential:
+		if(otherPopulationDensity > populationDensity && (buildingType == Commercial || buildingType == Industrial))
 		{
-			building->onFire--;
+			return SIM_LOCAL_BUILDING_INFLUENCE;
 		}
-		else if ((GetRand() & 0xff) > SIM_FIRE_SPREAD_CHANCE || !SpreadFire(building))
+		break;
+		case Commercial:
+		if(otherPopulationDensity >= populationDensity && buildingType == Residential)
 		{
-			if ((GetRand() & 0xff) < SIM_FIRE_BURN_CHANCE)
-			{
-				if (building->onFire >= BUILDING_MAX_FIRE_COUNTER)
-				{
-					DestroyBuilding(building);
-					building->onFire = BUILDING_MAX_FIRE_COUNTER;
-				}
-				else
-				{
-					building->onFire++;
-				}
-			}
+			return SIM_LOCAL_BUILDING_INFLUENCE;
 		}
-		building->heavyTraffic = false;
+		break;
+		case Stadium:
+		if(buildingType == Residential || buildingType == Commercial)
+		{
+			return SIM_STADIUM_BOOST;
+		}
+		break;
+#ifndef USE_LAND_VALUE
+		case Park:
+		if(buildingType == Residential)
+		{
+			return SIM_PARK_BOOST;
+		}
+		break;
+#endif
+		default:
+		break;
 	}
-	else if (building->type == Residential || building->type == Commercial || building->type == Industrial)
+
+	return 0;
+}
+
+#ifdef USE_BUILDING_INDEX
+
+#if !defined(USE_POLLUTION_FIELD) || !defined(USE_COVERAGE_MAPS)
+#error The building index relies on the pollution and coverage maps
+#endif
+
+// Pollution and police come from the maps, leaving the influence from buildings which are running,
+// connected to the roads and close enough. These are added up from the index's arrays a row of cells at a time
+static void SimulateNeighbourhood(Building* building, uint8_t* closestPoliceStationDistance, int16_t* pollution, int16_t* localInfluence)
+{
+	*pollution = GetPollutionFromNeighbours(building);
+
+	uint8_t policeDistance = GetPoliceDistance(building->x, building->y);
+	if (policeDistance < *closestPoliceStationDistance)
 	{
-		if (building->hasPower)
+		*closestPoliceStationDistance = policeDistance;
+	}
+
+	uint8_t start, end;
+
+	BuildingQuery query;
+	BeginBuildingQuery(&query, building->x, building->y, SIM_LOCAL_BUILDING_DISTANCE, ALL_BUILDING_TYPES_MASK);
+
+	LocalInfluenceQuery influenceQuery;
+	BeginLocalInfluence(&influenceQuery, building, SIM_LOCAL_BUILDING_DISTANCE);
+
+	while (NextBuildingSpan(&query, &start, &end))
+	{
+		*localInfluence += SumLocalInfluence(&influenceQuery, start, end);
+	}
+}
+
+#else
+
+static void SimulateNeighbourhood(Building* building, uint8_t* closestPoliceStationDistance, int16_t* pollution, int16_t* localInfluence)
+{
+	// Nothing further away than SIM_LOCAL_BUILDING_DISTANCE has any effect, pollution and police fall off sooner
+	BuildingQuery query;
+	BeginBuildingQuery(&query, building->x, building->y, SIM_LOCAL_BUILDING_DISTANCE, ALL_BUILDING_TYPES_MASK);
+
+	while(Building* otherBuilding = NextBuilding(&query))
+	{
+		if(building != otherBuilding && (otherBuilding->hasPower || otherBuilding->type == Park) && !otherBuilding->onFire)
 		{
-			int score = 0;
-			
-			// random effect
-			int randomEffect = (GetRand() & SIM_RANDOM_STRENGTH_MASK) - (SIM_RANDOM_STRENGTH_MASK / 2);
-			score += randomEffect;
+			uint8_t distance = query.distance;
 			
-			// tend towards average population density
-			score += (AVERAGE_POPULATION_DENSITY - building->populationDensity) * SIM_AVERAGING_STRENGTH;
-			
-			// tax rate effect
-			score -= (State.taxRate - SIM_IDEAL_TAX_RATE) * SIM_TAX_RATE_PENALTY;
-
-			// general population effect
-			int populationEffect = 0;
-			switch(building->type)
+			if(otherBuilding->type == PoliceDept && distance < *closestPoliceStationDistance)
 			{
-				case Residential:
-				if(State.residentialPopulation < State.industrialPopulation)
-				{
-					populationEffect += SIM_EMPLOYMENT_BOOST;
-				}
-				else if(State.residentialPopulation > State.industrialPopulation + State.commercialPopulation)
-				{
-					populationEffect -= SIM_UNEMPLOYMENT_PENALTY;
-				}
-				break;
-				case Industrial:
-				if(State.industrialPopulation < State.residentialPopulation || State.industrialPopulation < State.commercialPopulation)
-				{
-					populationEffect += SIM_INDUSTRIAL_OPPORTUNITY_BOOST;
-				}
-				break;
-				case Commercial:
-				if(State.commercialPopulation < State.residentialPopulation || State.commercialPopulation < State.industrialPopulation)
-				{
-					populationEffect += SIM_COMMERCIAL_OPPORTUNITY_BOOST;
-				}
-				break;
+				*closestPoliceStationDistance = distance;
 			}
-			score += populationEffect;
 			
-			// If at least 3 road tiles are adjacent then assume that it is connected to the road network
-			bool isRoadConnected = GetNumRoadConnections(building) >= 3;
+			int buildingPollution = GetPollutionStrength(otherBuilding) - distance;
 			
-			uint8_t closestPoliceStationDistance = 24;
-			int16_t pollution = 0;
-			int16_t localInfluence = 0;
+			if(buildingPollution > 0)
+				*pollution += buildingPollution;
 			
-			// influence from local buildings
-			if(isRoadConnected)
+			if(distance <= SIM_LOCAL_BUILDING_DISTANCE && IsRoadConnected(otherBuilding))
 			{
-				if (building->populationDensity == 0)
-				{
-					score += SIM_BASE_SCORE;
-				}
-
-				for(int n = 0; n < MAX_BUILDINGS; n++)
-				{
-					Building* otherBuilding = &State.buildings[n];
-					
-					if(building != otherBuilding && otherBuilding->type && (otherBuilding->hasPower || otherBuilding->type == Park) && !otherBuilding->onFire)
-					{
-						uint8_t distance = GetManhattanDistance(building, otherBuilding);
-						
-						if(otherBuilding->type == PoliceDept && distance < closestPoliceStationDistance)
-						{
-							closestPoliceStationDistance = distance;
-						}
-						
-						int buildingPollution = 0;
-						
-						if(otherBuilding->type == Industrial)
-						{
-							buildingPollution = SIM_INDUSTRIAL_BASE_POLLUTION + otherBuilding->populationDensity - distance;
-						}
-						else if(otherBuilding->type == Powerplant)
-						{
-							buildingPollution = SIM_POWERPLANT_BASE_POLLUTION - distance;
-						}
-						else if(otherBuilding->heavyTraffic)
-						{
-							buildingPollution = SIM_TRAFFIC_BASE_POLLUTION - distance;
-						}
-						
-						if(buildingPollution > 0)
-							pollution += buildingPollution;
-						
-						if(distance <= SIM_LOCAL_BUILDING_DISTANCE && GetNumRoadConnections(otherBuilding) >= 3)
-						{
-							switch(otherBuilding->type)
-							{
-								case Industrial:
-								if(otherBuilding->populationDensity >= building->populationDensity && building->type == Residential)
-								{
-									localInfluence += SIM_LOCAL_BUILDING_INFLUENCE;
-								}
-								else if (otherBuilding->populationDensity > building->populationDensity && building->type == Commercial)
-								{
-									localInfluence += SIM_LOCAL_BUILDING_INFLUENCE;
-								}
-								break;
-								case Residential:
-								if(otherBuilding->populationDensity > building->populationDensity && (building->type == Commercial || building->type == Industrial))
-								{
-									localInfluence += SIM_LOCAL_BUILDING_INFLUENCE;
-								}
-								break;
-								case Commercial:
-								if(otherBuilding->populationDensity >= building->populationDensity && building->type == Residential)
-								{
-									localInfluence += SIM_LOCAL_BUILDING_INFLUENCE;
-								}
-								break;
-								case Stadium:
-								if(building->type == Residential || building->type == Commercial)
-								{
-									localInfluence += SIM_STADIUM_BOOST;
-								}
-								break;
-								case Park:
-								if(building->type == Residential)
-								{
-									localInfluence += SIM_PARK_BOOST;
-								}
-								break;
-								default:
-								break;
-							}
-						}
-					}
-				}
+				*localInfluence += GetLocalInfluence(building->type, building->populationDensity, otherBuilding->type, otherBuilding->populationDensity);
 			}
+		}
+	}
+}
 
-			score += localInfluence;
-			
-			// negative effect from pollution
-			if (building->type == Residential)
-			{
-				if (pollution > SIM_MAX_POLLUTION)
-					pollution = SIM_MAX_POLLUTION;
-				score -= pollution * SIM_POLLUTION_INFLUENCE;
+#endif
+
+// How the zone type is doing compared to the others
+static int GetPopulationEffect(uint8_t type)
+{
+	int populationEffect = 0;
+	switch(type)
+	{
+		case Residential:
+		if(City.state.residentialPopulation < City.state.industrialPopulation)
+		{
+			populationEffect += SIM_EMPLOYMENT_BOOST;
+		}
+		else if(City.state.residentialPopulation > City.state.industrialPopulation + City.state.commercialPopulation)
+		{
+			populationEffect -= SIM_UNEMPLOYMENT_PENALTY;
+		}
+		break;
+		case Industrial:
+		if(City.state.industrialPopulation < City.state.residentialPopulation || City.state.industrialPopulation < City.state.commercialPopulation)
+		{
+			populationEffect += SIM_INDUSTRIAL_OPPORTUNITY_BOOST;
+		}
+		break;
+		case Commercial:
+		if(City.state.commercialPopulation < City.state.residentialPopulation || City.state.commercialPopulation < City.state.industrialPopulation)
+		{
+			populationEffect += SIM_COMMERCIAL_OPPORTUNITY_BOOST;
+		}
+		break;
+	}
+	return populationEffect;
+}
+
+#ifdef USE_ZONE_SCHEDULER
+static void RecordZoneScore(Building* building, int score);
+#endif
+
+// How a powered zone's population density changes this step, reads City.state but doesn't change it
+static int8_t ScoreZone(Building* building, int randomEffect)
+{
+	int score = 0;
+	
+	// tend towards average population density
+	score += (AVERAGE_POPULATION_DENSITY - building->populationDensity) * SIM_AVERAGING_STRENGTH;
+	
+	// tax rate effect
+	score -= (City.state.taxRate - SIM_IDEAL_TAX_RATE) * SIM_TAX_RATE_PENALTY;
+
+	// general population effect
+	int populationEffect = GetPopulationEffect(building->type);
+	score += populationEffect;
+	
+	bool isRoadConnected = IsRoadConnected(building);
+	
+	uint8_t closestPoliceStationDistance = 24;
+	int16_t pollution = 0;
+	int16_t localInfluence = 0;
+	
+	// influence from local buildings
+	if(isRoadConnected)
+	{
+		if (building->populationDensity == 0)
+		{
+			score += SIM_BASE_SCORE;
+		}
+
+		SimulateNeighbourhood(building, &closestPoliceStationDistance, &pollution, &localInfluence);
+	}
+
+	score += localInfluence;
+	
+	// negative effect from pollution
+	if (building->type == Residential)
+	{
+		if (pollution > SIM_MAX_POLLUTION)
+			pollution = SIM_MAX_POLLUTION;
+		score -= pollution * SIM_POLLUTION_INFLUENCE;
 #if _WIN32
-//				printf("Pollution: %d\n", pollution * SIM_POLLUTION_INFLUENCE);
+//			printf("Pollution: %d\n", pollution * SIM_POLLUTION_INFLUENCE);
 #endif
-			}
-			
-			// simulate crime based on how far the closest police station is and how populated the area is
-			int crime = (building->populationDensity * (closestPoliceStationDistance - 16));
-			if(crime > SIM_MAX_CRIME)
-			{
-				crime = SIM_MAX_CRIME;
-			}
-			else if (crime < 0)
-			{
-				crime = 0;
-			}
+#ifdef USE_LAND_VALUE
+		// Parks and water go into the land value, which only counts with a road
+		if (isRoadConnected)
+			score += GetLandValue(building->x, building->y);
+#endif
+	}
+	
+	// simulate crime based on how far the closest police station is and how populated the area is
+	int crime = (building->populationDensity * (closestPoliceStationDistance - 16));
+	if(crime > SIM_MAX_CRIME)
+	{
+		crime = SIM_MAX_CRIME;
+	}
+	else if (crime < 0)
+	{
+		crime = 0;
+	}
 
-			score -= crime;
+	score -= crime;
 
-			DebugBuildingScore(building, score, crime, pollution * SIM_POLLUTION_INFLUENCE, localInfluence, populationEffect, randomEffect);
-			
-			// increase or decrease population density based on score
-			if (building->populationDensity < MAX_POPULATION_DENSITY && score >= SIM_INCREMENT_POP_THRESHOLD)
+	// random effect, everything else is the same whatever it is
+#ifdef USE_ZONE_SCHEDULER
+	RecordZoneScore(building, score);
+#endif
+	score += randomEffect;
+
+	DebugBuildingScore(building, score, crime, pollution * SIM_POLLUTION_INFLUENCE, localInfluence, populationEffect, randomEffect);
+	
+	// increase or decrease population density based on score
+	if (building->populationDensity < MAX_POPULATION_DENSITY && score >= SIM_INCREMENT_POP_THRESHOLD)
+	{
+		return 1;
+	}
+	else if(building->populationDensity > 0 && score <= SIM_DECREMENT_POP_THRESHOLD)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+static int GetRandomEffect(Building* building)
+{
+	return (GetSimulationRand(building - City.state.buildings, RandomPurpose_ZoneScore, 0) & SIM_RANDOM_STRENGTH_MASK) - (SIM_RANDOM_STRENGTH_MASK / 2);
+}
+
+#ifdef USE_ZONE_SCHEDULER
+static inline uint8_t GetZoneScheduleKind(Building* building)
+{
+	return building->type | (building->hasPower ? 0x10 : 0) | (building->onFire ? 0x20 : 0);
+}
+
+// Which zone types are getting a boost or a penalty from the population totals
+static uint8_t GetPopulationEffectSignature()
+{
+	int residential = GetPopulationEffect(Residential);
+	return (residential > 0 ? 1 : 0) | (residential < 0 ? 2 : 0)
+		| (GetPopulationEffect(Industrial) ? 4 : 0) | (GetPopulationEffect(Commercial) ? 8 : 0);
+}
+
+static void RecordZoneScore(Building* building, int score)
+{
+	const int maxRandomEffect = SIM_RANDOM_STRENGTH_MASK - SIM_RANDOM_STRENGTH_MASK / 2;
+	const int minRandomEffect = -(SIM_RANDOM_STRENGTH_MASK / 2);
+	uint8_t slot = building - City.state.buildings;
+
+	bool cantGrow = building->populationDensity == MAX_POPULATION_DENSITY
+		|| score + maxRandomEffect + ZONE_SETTLED_MARGIN < SIM_INCREMENT_POP_THRESHOLD;
+	bool cantShrink = building->populationDensity == 0
+		|| score + minRandomEffect - ZONE_SETTLED_MARGIN > SIM_DECREMENT_POP_THRESHOLD;
+
+	// Only touches its own slot so the month's scores can be worked out on any thread
+	City.zoneSettledMonths[slot] = City.zoneSchedule == ZoneSchedule_Settled && cantGrow && cantShrink ? ZONE_SETTLED_INTERVAL - 1 : 0;
+}
+
+// The tax rate and the population totals go into every zone's score
+static void CheckZoneScheduleInputs()
+{
+	uint8_t populationEffects = GetPopulationEffectSignature();
+
+	if (City.state.taxRate != City.zoneScheduleTaxRate || populationEffects != City.zoneSchedulePopulationEffects)
+	{
+		City.zoneScheduleTaxRate = City.state.taxRate;
+		City.zoneSchedulePopulationEffects = populationEffects;
+		InvalidateZoneSchedule();
+	}
+}
+
+// True when a settled zone can go without being scored this month
+static bool SkipSettledZone(Building* building)
+{
+	if (City.zoneSchedule == ZoneSchedule_Exact)
+		return false;
+
+	CheckZoneScheduleInputs();
+
+	uint8_t slot = building - City.state.buildings;
+	if (City.zoneSettledMonths[slot])
+	{
+		City.zoneSettledMonths[slot]--;
+		return true;
+	}
+	return false;
+}
+
+void SetZoneSchedule(uint8_t schedule)
+{
+	City.zoneSchedule = schedule;
+	InvalidateZoneSchedule();
+}
+
+uint8_t GetZoneSchedule()
+{
+	return City.zoneSchedule;
+}
+
+void UpdateZoneSchedule(Building* building)
+{
+	uint8_t slot = building - City.state.buildings;
+	uint8_t kind = GetZoneScheduleKind(building);
+
+	// A building coming or going changes the neighbourhood of every zone around it
+	if (kind != City.zoneScheduleKinds[slot])
+	{
+		City.zoneScheduleKinds[slot] = kind;
+		InvalidateZoneSchedule();
+	}
+	else if (building->populationDensity != City.zoneScheduleDensities[slot])
+	{
+		City.zoneSettledMonths[slot] = 0;
+	}
+	City.zoneScheduleDensities[slot] = building->populationDensity;
+}
+
+void InvalidateZoneSchedule()
+{
+	memset(City.zoneSettledMonths, 0, sizeof(City.zoneSettledMonths));
+}
+
+void ResetZoneSchedule()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		City.zoneScheduleKinds[n] = GetZoneScheduleKind(&City.state.buildings[n]);
+		City.zoneScheduleDensities[n] = City.state.buildings[n].populationDensity;
+	}
+	City.zoneScheduleTaxRate = City.state.taxRate;
+	City.zoneSchedulePopulationEffects = GetPopulationEffectSignature();
+	InvalidateZoneSchedule();
+}
+#endif
+
+static int8_t GetZoneDensityChange(Building* building)
+{
+#ifdef USE_MONTH_SIMULATION
+	uint8_t slot = building - City.state.buildings;
+	if (City.monthDensityChangeScored[slot])
+	{
+		City.monthDensityChangeScored[slot] = false;
+		return City.monthDensityChanges[slot];
+	}
+#endif
+	return ScoreZone(building, GetRandomEffect(building));
+}
+
+void SimulateFire(Building* building, uint8_t draw)
+{
+	uint8_t slot = building - City.state.buildings;
+
+	if (IsRubble(building->type))
+	{
+		building->onFire--;
+		if ((GetSimulationRand(slot, RandomPurpose_FireSpreadChance, draw) & 0xff) > SIM_FIRE_SPREAD_CHANCE)
+		{
+			SpreadFire(building, draw);
+		}
+		UpdateBuildingCaches(building);
+		RefreshBuildingTiles(building);
+		return;
+	}
+
+	// Find closest fire department
+	uint8_t closestFireDept = 0xff;
+
+#ifdef USE_COVERAGE_MAPS
+	closestFireDept = GetFireDeptDistance(building->x, building->y);
+#else
+	BuildingQuery query;
+	BeginBuildingQuery(&query, building->x, building->y, 0xff, BuildingTypeMask(FireDept));
+
+	while (Building* otherBuilding = NextBuilding(&query))
+	{
+		if (IsFireCoverageSource(otherBuilding) && query.distance < closestFireDept)
+		{
+			closestFireDept = query.distance;
+		}
+	}
+#endif
+
+	int fireDeptInfluence = SIM_FIRE_DEPT_BASE_INFLUENCE + closestFireDept * SIM_FIRE_DEPT_INFLUENCE_MULTIPLIER;
+	
+	if (fireDeptInfluence <= 255 && (GetSimulationRand(slot, RandomPurpose_FireFighting, draw) & 0xff) > (uint8_t)(fireDeptInfluence))
+	{
+		building->onFire--;
+	}
+	else if ((GetSimulationRand(slot, RandomPurpose_FireSpreadChance, draw) & 0xff) > SIM_FIRE_SPREAD_CHANCE || !SpreadFire(building, draw))
+	{
+		if ((GetSimulationRand(slot, RandomPurpose_FireBurn, draw) & 0xff) < SIM_FIRE_BURN_CHANCE)
+		{
+			if (building->onFire >= BUILDING_MAX_FIRE_COUNTER)
 			{
-				populationDensityChange = 1;
+				DestroyBuilding(building);
+				building->onFire = BUILDING_MAX_FIRE_COUNTER;
 			}
-			else if(building->populationDensity > 0 && score <= SIM_DECREMENT_POP_THRESHOLD)
+			else
 			{
-				populationDensityChange = -1;
+				building->onFire++;
 			}
-			
+		}
+	}
+	building->heavyTraffic = false;
+
+	UpdateBuildingCaches(building);
+	RefreshBuildingTiles(building);
+}
+
+void SimulateBuilding(Building* building)
+{
+	TRACE_ZONE("SimulateBuilding");
+
+	// Saves from before clearing rubble put its fire out can have empty slots still counting down a fire,
+	// which would otherwise burn as a building with no type and turn back into rubble
+	if (!building->type)
+		return;
+
+	if (building->onFire)
+	{
+		// Fire tracking builds tick the fires separately with SimulateFires
+#ifndef USE_FIRE_TRACKING
+		SimulateFire(building, 0);
+#endif
+		return;
+	}
+
+	int8_t populationDensityChange = 0;
+	bool hadHeavyTraffic = building->heavyTraffic;
+
+	if (building->type == Residential || building->type == Commercial || building->type == Industrial)
+	{
+		if (building->hasPower)
+		{
+#ifdef USE_ZONE_SCHEDULER
+			if (!SkipSettledZone(building))
+				populationDensityChange = GetZoneDensityChange(building);
+#else
+			populationDensityChange = GetZoneDensityChange(building);
+#endif
+#ifdef USE_TRAFFIC_FLOW
+			building->heavyTraffic = GetZoneTraffic(building) >= SIM_HEAVY_TRAFFIC_LOAD;
+#else
 			building->heavyTraffic = building->populationDensity > SIM_HEAVY_TRAFFIC_THRESHOLD;
+#endif
 		}
 		else
 		{
@@ -454,68 +750,192 @@ void SimulateBuilding(Building* building)
 		}
 	}
 
+	// Only zones whose density or traffic changed look any different, the rest
+	// (most of them in a settled city) can leave the caches and the visible tiles as they are
+	if (populationDensityChange == 0 && building->heavyTraffic == hadHeavyTraffic)
+		return;
+
 	building->populationDensity += populationDensityChange;
+	AddZonePopulation(building, populationDensityChange);
+	UpdateBuildingCaches(building);
+
+	RefreshBuildingTiles(building);
+}
+
+void AddZonePopulation(Building* building, int populationChange)
+{
 	switch (building->type)
 	{
 	case Residential:
-		State.residentialPopulation += populationDensityChange;
+		City.state.residentialPopulation += populationChange;
 		break;
 	case Industrial:
-		State.industrialPopulation += populationDensityChange;
+		City.state.industrialPopulation += populationChange;
 		break;
 	case Commercial:
-		State.commercialPopulation += populationDensityChange;
+		City.state.commercialPopulation += populationChange;
 		break;
 	}
+}
 
-	RefreshBuildingTiles(building);
+void ResetSimulationCaches()
+{
+	ResetRoadConnections();
+	RebuildBuildingIndex();
+#ifdef USE_BUILDING_INDEX
+	InitInfluenceKernels();
+#endif
+	ResetPollution();
+	ResetCoverage();
+	ResetFires();
+	ResetTraffic();
+	UpdateLandValue();
+	ResetZoneSchedule();
+#ifdef USE_SIMULATION_SCHEDULER
+	CancelPowerConnectivity();
+	City.simulationStepsOwed = 0;
+#endif
+
+	// Saves from before the totals were kept up to date can be out by whatever changed since the last recount
+	CountPopulation();
 }
 
-void CountPopulation()
+static void AddUpPopulation(uint16_t* residential, uint16_t* industrial, uint16_t* commercial)
 {
-	State.residentialPopulation = State.industrialPopulation = State.commercialPopulation = 0;
+	*residential = *industrial = *commercial = 0;
 
+#ifdef USE_BUILDING_INDEX
+	for (int n = 0; n < City.indexedBuildings.count; n++)
+	{
+		uint8_t type = City.indexedBuildings.type[n];
+		uint8_t populationDensity = City.indexedBuildings.populationDensity[n];
+
+		*residential += type == Residential ? populationDensity : 0;
+		*industrial += type == Industrial ? populationDensity : 0;
+		*commercial += type == Commercial ? populationDensity : 0;
+	}
+#else
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		switch (State.buildings[n].type)
+		switch (City.state.buildings[n].type)
 		{
 		case Residential:
-			State.residentialPopulation += State.buildings[n].populationDensity;
+			*residential += City.state.buildings[n].populationDensity;
 			break;
 		case Industrial:
-			State.industrialPopulation += State.buildings[n].populationDensity;
+			*industrial += City.state.buildings[n].populationDensity;
 			break;
 		case Commercial:
-			State.commercialPopulation += State.buildings[n].populationDensity;
+			*commercial += City.state.buildings[n].populationDensity;
 			break;
 		default:
 			break;
 		}
 	}
+#endif
+}
+
+void CountPopulation()
+{
+	AddUpPopulation(&City.state.residentialPopulation, &City.state.industrialPopulation, &City.state.commercialPopulation);
+}
+
+#ifdef ENABLE_CHECKS
+static void CheckRunningTotals()
+{
+	// Counted from the buildings rather than the index so a missed index update shows up too
+	uint16_t residential = 0, industrial = 0, commercial = 0;
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		residential += building->type == Residential ? building->populationDensity : 0;
+		industrial += building->type == Industrial ? building->populationDensity : 0;
+		commercial += building->type == Commercial ? building->populationDensity : 0;
+	}
+
+	if (residential != City.state.residentialPopulation || industrial != City.state.industrialPopulation || commercial != City.state.commercialPopulation)
+	{
+		fprintf(stderr, "Population totals %d/%d/%d don't match the buildings' %d/%d/%d\n",
+			City.state.residentialPopulation, City.state.industrialPopulation, City.state.commercialPopulation, residential, industrial, commercial);
+		abort();
+	}
+
+#ifdef USE_BUILDING_INDEX
+	BuildingTypeTotals totals[NUM_BUILDING_TYPE_TOTALS];
+	AddUpBuildingTypeTotals(totals);
+
+	if (memcmp(totals, City.buildingTypeTotals, sizeof(totals)))
+	{
+		fprintf(stderr, "Building type totals don't match the buildings\n");
+		abort();
+	}
+#endif
+
+#ifdef USE_ROAD_CONNECTION_CACHE
+	int numRoadTiles = CountRoadTiles();
+
+	if (numRoadTiles != City.numRoadTiles)
+	{
+		fprintf(stderr, "Road tile count %d doesn't match the connection map's %d\n", City.numRoadTiles, numRoadTiles);
+		abort();
+	}
+#endif
+
+#ifdef USE_BUILDING_INDEX
+	CheckBuildingTileMap();
+#endif
+#ifdef USE_FIRE_TRACKING
+	CheckFires();
+#endif
+#ifdef USE_TRAFFIC_FLOW
+	CheckTraffic();
+#endif
 }
+#endif
 
 void Simulate()
 {
-	if (State.simulationStep < MAX_BUILDINGS)
+	TRACE_ZONE("Simulate");
+
+#ifdef USE_FIRE_TRACKING
+	// Counted from the start of 1900 so the cadence carries on across months and saved games
+	uint32_t stepsSinceStart = ((uint32_t)City.state.year * 12 + City.state.month) * (SimulateNextMonth + 1) + City.state.simulationStep;
+	if (stepsSinceStart % FIRE_TICK_INTERVAL == 0)
 	{
-		SimulateBuilding(&State.buildings[State.simulationStep]);
+		SimulateFires((uint8_t)(stepsSinceStart / FIRE_TICK_INTERVAL));
 	}
-	else switch (State.simulationStep)
+#endif
+#ifdef USE_TRAFFIC_FLOW
+	SimulateTraffic(TRAFFIC_WORK_PER_STEP);
+#endif
+
+	if (City.state.simulationStep < MAX_BUILDINGS)
+	{
+		SimulateBuilding(&City.state.buildings[City.state.simulationStep]);
+	}
+	else switch (City.state.simulationStep)
 	{
 	case SimulatePower:
 		CalculatePowerConnectivity();
+		UpdateCoverage();
+		UpdateLandValue();
 		break;
 	case SimulatePopulation:
-		CountPopulation();
+		// The totals are kept up to date as buildings change, the step is kept so months are the same length
+#ifdef ENABLE_CHECKS
+		CheckRunningTotals();
+#endif
 		break;
 	case SimulateNextMonth:
 	{
-		State.simulationStep = 0;
-		State.month++;
-		if (State.month >= 12)
+		City.state.simulationStep = 0;
+		City.state.month++;
+		if (City.state.month >= 12)
 		{
-			State.month = 0;
-			State.year++;
+			City.state.month = 0;
+			City.state.year++;
 
 			DoBudget();
 		}
@@ -523,35 +943,241 @@ void Simulate()
 	return;
 	}
 
-	State.simulationStep++;
-	State.timeToNextDisaster--;
+	City.state.simulationStep++;
+	City.state.timeToNextDisaster--;
 
-	if (State.timeToNextDisaster == 0)
+	if (City.state.timeToNextDisaster == 0)
 	{
 		StartRandomFire();
-		State.timeToNextDisaster = (GetRand() % (MAX_TIME_BETWEEN_DISASTERS - MIN_TIME_BETWEEN_DISASTERS)) + MIN_TIME_BETWEEN_DISASTERS;
+		City.state.timeToNextDisaster = (GetSimulationRand(City.state.simulationStep, RandomPurpose_DisasterTimer, 0) % (MAX_TIME_BETWEEN_DISASTERS - MIN_TIME_BETWEEN_DISASTERS)) + MIN_TIME_BETWEEN_DISASTERS;
 	}
 }
 
-bool StartRandomFire()
+#ifdef USE_MONTH_SIMULATION
+static void ScoreMonthZone(void* context, int index)
 {
-	int attemptsLeft = MAX_BUILDINGS;
+	uint8_t slot = City.monthZoneSlots[index];
+	City.monthDensityChanges[slot] = ScoreZone(&City.state.buildings[slot], City.monthRandomEffects[slot]);
+}
+
+void SimulateMonth()
+{
+	TRACE_ZONE("SimulateMonth");
+	int numZones = 0;
+
+	// The random effects are drawn in building order so they don't depend on the threads (cities with a
+	// seed get the same ones as stepping through the month). Anything the scores look up lazily is filled
+	// in first as the workers only read
+	UpdateCoverage();
+#ifdef USE_ZONE_SCHEDULER
+	if (City.zoneSchedule != ZoneSchedule_Exact)
+	{
+		CheckZoneScheduleInputs();
+	}
+#endif
 
-	while (attemptsLeft)
+	for (int n = City.state.simulationStep; n < MAX_BUILDINGS; n++)
 	{
-		int index = GetRand() & 0xff;
-		if (index < MAX_BUILDINGS && State.buildings[index].type && !State.buildings[index].onFire && !IsRubble(State.buildings[index].type) && State.buildings[index].type != Park)
+		Building* building = &City.state.buildings[n];
+
+#ifdef USE_ZONE_SCHEDULER
+		// Settled zones won't be scored when their turn comes
+		if (City.zoneSettledMonths[n])
+			continue;
+#endif
+		if (!building->onFire && building->hasPower
+			&& (building->type == Residential || building->type == Commercial || building->type == Industrial))
 		{
-			State.buildings[index].onFire = 1;
-			RefreshBuildingTiles(&State.buildings[index]);
-			FocusTile(State.buildings[index].x + 1, State.buildings[index].y + 1);
+			City.monthZoneSlots[numZones++] = n;
+			City.monthRandomEffects[n] = GetRandomEffect(building);
+			IsRoadConnected(building);
+		}
+	}
+
+	ParallelFor(numZones, ScoreMonthZone, nullptr);
+
+	for (int n = 0; n < numZones; n++)
+	{
+		City.monthDensityChangeScored[City.monthZoneSlots[n]] = true;
+	}
+
+	do
+	{
+		Simulate();
+	} while (City.state.simulationStep != 0);
+
+	// Zones which caught fire part way through the month didn't use their score
+	memset(City.monthDensityChangeScored, 0, sizeof(City.monthDensityChangeScored));
+}
+#endif
 
-			UIState.state = InGameDisaster;
-			UIState.selection = DISASTER_MESSAGE_DISPLAY_TIME;
-			return true;
+#ifdef USE_FAST_FORWARD
+// How many steps to run between looking at the clock, a bit more than a month
+#define FAST_FORWARD_CLOCK_INTERVAL 256
+
+uint8_t FastForward(uint16_t targetYear, uint8_t targetMonth, uint32_t maxMilliseconds)
+{
+	TRACE_ZONE("FastForward");
+	auto endTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxMilliseconds);
+	uint8_t result = FastForward_ReachedDate;
+	int stepsUntilClockCheck = FAST_FORWARD_CLOCK_INTERVAL;
+
+	SuspendVisibleTileCache(true);
+
+	while (City.state.year < targetYear || (City.state.year == targetYear && City.state.month < targetMonth))
+	{
+		if (City.uiState.state == InGameDisaster)
+		{
+			result = FastForward_Disaster;
+			break;
 		}
-		attemptsLeft--;
+		if (City.uiState.state != InGame && City.uiState.state != ShowingToolbar)
+		{
+			result = FastForward_Paused;
+			break;
+		}
+		if (maxMilliseconds && --stepsUntilClockCheck == 0)
+		{
+			if (std::chrono::steady_clock::now() >= endTime)
+			{
+				result = FastForward_OutOfTime;
+				break;
+			}
+			stepsUntilClockCheck = FAST_FORWARD_CLOCK_INTERVAL;
+		}
+
+		Simulate();
 	}
 
-	return false;
+	SuspendVisibleTileCache(false);
+
+	return result;
+}
+#endif
+
+#ifdef USE_SIMULATION_SCHEDULER
+// How many spans of the power fill to do between looking at the clock
+#define POWER_FILL_CHUNK 32
+
+uint16_t SimulateWithBudget(uint32_t budgetMicroseconds, uint16_t maxSteps)
+{
+	TRACE_ZONE("SimulateWithBudget");
+	auto endTime = std::chrono::steady_clock::now() + std::chrono::microseconds(budgetMicroseconds);
+	uint16_t numSteps = 0;
+
+	while (numSteps < maxSteps && (City.uiState.state == InGame || City.uiState.state == ShowingToolbar))
+	{
+		// Nothing else runs until the fill has finished, so splitting it up gives the same result as long
+		// as the power lines don't change in between, and SetConnections starts it again if they do
+		if (City.state.simulationStep == SimulatePower)
+		{
+			while (!UpdatePowerConnectivity(POWER_FILL_CHUNK))
+			{
+				if (std::chrono::steady_clock::now() >= endTime)
+					return numSteps;
+			}
+		}
+
+		Simulate();
+		numSteps++;
+
+		if (std::chrono::steady_clock::now() >= endTime)
+			break;
+	}
+
+	return numSteps;
+}
+
+void SetSimulationBudget(uint32_t budgetMicroseconds, uint16_t stepsPerFrame)
+{
+	City.simulationBudget = budgetMicroseconds;
+	City.simulationStepsPerFrame = stepsPerFrame;
+	City.simulationStepsOwed = 0;
+}
+#endif
+
+void SimulateFrame()
+{
+#ifdef USE_SIMULATION_SCHEDULER
+	if (City.simulationBudget)
+	{
+		uint16_t stepsPerFrame = City.simulationStepsPerFrame;
+
+		if (stepsPerFrame == SIMULATION_STEPS_UNLIMITED)
+		{
+			SimulateWithBudget(City.simulationBudget, SIMULATION_STEPS_UNLIMITED);
+			return;
+		}
+
+		// Falling behind by more than a month isn't worth catching up on
+		uint32_t steps = City.simulationStepsOwed + stepsPerFrame;
+		if (steps > SimulateNextMonth + 1)
+			steps = SimulateNextMonth + 1;
+
+		City.simulationStepsOwed = (uint16_t)(steps - SimulateWithBudget(City.simulationBudget, (uint16_t)steps));
+		return;
+	}
+#endif
+
+	Simulate();
+}
+
+bool StartRandomFire()
+{
+	Building* building = nullptr;
+
+#ifdef USE_FIRE_TRACKING
+	building = PickFlammableBuilding(GetSimulationRand(City.state.simulationStep, RandomPurpose_Disaster, 0));
+#else
+	for (int attempt = 0; attempt < MAX_BUILDINGS && !building; attempt++)
+	{
+		int index = GetSimulationRand(City.state.simulationStep, RandomPurpose_Disaster, attempt) & 0xff;
+		if (index < MAX_BUILDINGS && CanCatchFire(&City.state.buildings[index]))
+		{
+			building = &City.state.buildings[index];
+		}
+	}
+#endif
+
+	if (!building)
+		return false;
+
+	building->onFire = 1;
+	UpdateBuildingCaches(building);
+	RefreshBuildingTiles(building);
+	FocusTile(building->x + 1, building->y + 1);
+
+	City.uiState.state = InGameDisaster;
+	City.uiState.selection = DISASTER_MESSAGE_DISPLAY_TIME;
+	return true;
 }
+
+#ifdef USE_CITY_CONTEXT
+void Simulate(CityContext* city)
+{
+	CurrentCityScope scope(city);
+	Simulate();
+}
+
+#ifdef USE_MONTH_SIMULATION
+void SimulateMonth(CityContext* city)
+{
+	CurrentCityScope scope(city);
+	SimulateMonth();
+}
+#endif
+
+#ifdef USE_FAST_FORWARD
+uint8_t FastForward(CityContext* city, uint16_t targetYear, uint8_t targetMonth, uint32_t maxMilliseconds)
+{
+	CurrentCityScope scope(city);
+	return FastForward(targetYear, targetMonth, maxMilliseconds);
+}
+#endif
+
+void ResetSimulationCaches(CityContext* city)
+{
+	CurrentCityScope scope(city);
+	ResetSimulationCaches();
+}
+#endif
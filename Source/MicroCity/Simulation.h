@@ -1,4 +1,134 @@
 #pragma once
 
+#include "Building.h"
+#include "BuildingIndex.h"
+#include "Coverage.h"
+#include "Fire.h"
+#include "LandValue.h"
+#include "Pollution.h"
+#include "Traffic.h"
+
 void Simulate(void);
-bool StartRandomFire(void);
\ No newline at end of file
+bool StartRandomFire(void);
+
+#ifdef USE_MONTH_SIMULATION
+// Runs Simulate until the end of the month, with every powered zone scored up front in parallel against
+// the city as it was at the start. The changes are applied in building order as usual so the result
+// doesn't depend on the number of threads, but it isn't the same as calling Simulate one step at a time
+void SimulateMonth(void);
+#endif
+
+#ifdef USE_FAST_FORWARD
+enum FastForwardResult
+{
+	FastForward_ReachedDate,
+	FastForward_OutOfTime,
+	FastForward_Disaster,		// The game is showing the disaster message
+	FastForward_Paused			// The game wasn't simulating to begin with or the budget menu came up
+};
+
+// Calls Simulate until the start of targetMonth in targetYear (years since 1900), until maxMilliseconds
+// have passed (0 for no limit) or until something happens that the player needs to see. The visible
+// tile cache isn't kept up to date while running and is rebuilt once at the end
+uint8_t FastForward(uint16_t targetYear, uint8_t targetMonth, uint32_t maxMilliseconds);
+#endif
+
+#ifdef USE_SIMULATION_SCHEDULER
+#define SIMULATION_STEPS_UNLIMITED 0xffff
+
+// Runs up to maxSteps steps, stopping early once budgetMicroseconds have passed or the game stops
+// simulating. The power step's flood fill is done a chunk at a time and carries on in the next call if it
+// runs out of time, so no call has to do all of it. Returns the number of steps finished
+uint16_t SimulateWithBudget(uint32_t budgetMicroseconds, uint16_t maxSteps);
+
+// With a budget set TickGame runs stepsPerFrame steps a frame through SimulateWithBudget, catching up on
+// steps that didn't fit when there is time to spare. SIMULATION_STEPS_UNLIMITED runs as many as fit.
+// A budget of 0 goes back to one Simulate per tick, which is what replays need to stay deterministic
+void SetSimulationBudget(uint32_t budgetMicroseconds, uint16_t stepsPerFrame);
+#endif
+
+// What TickGame runs each frame
+void SimulateFrame(void);
+
+#ifdef USE_ZONE_SCHEDULER
+enum ZoneSchedule
+{
+	ZoneSchedule_Exact,			// Every zone is scored every month
+	ZoneSchedule_Settled		// Settled zones are only scored every ZONE_SETTLED_INTERVAL months
+};
+
+// How many months a settled zone goes between scores, and how far inside the no change range its
+// score has to be whatever the random effect
+#define ZONE_SETTLED_INTERVAL 4
+#define ZONE_SETTLED_MARGIN 4
+
+// A zone is settled when its score, without the random effect, can't change its density whichever random
+// effect it gets. Until its inputs change it would stay that way, so it is only scored again when they do
+// or once ZONE_SETTLED_INTERVAL months have gone by. Its own density, type, power and fire, any building
+// being built, destroyed, powered or set on fire, any road changing, the tax rate and which way the
+// population totals compare all count as inputs. Neighbouring densities don't, those can drift for up to
+// ZONE_SETTLED_INTERVAL months, which is what ZONE_SETTLED_MARGIN leaves room for
+void SetZoneSchedule(uint8_t schedule);
+uint8_t GetZoneSchedule(void);
+void UpdateZoneSchedule(Building* building);
+void InvalidateZoneSchedule(void);
+void ResetZoneSchedule(void);
+#else
+inline void UpdateZoneSchedule(Building* building) {}
+inline void ResetZoneSchedule() {}
+#endif
+
+// Rebuilds everything the simulation derives from City.state, call after City.state has been replaced
+void ResetSimulationCaches(void);
+
+#ifdef USE_CITY_CONTEXT
+// The functions above work on the current city, these work on the one given
+void Simulate(CityContext* city);
+#ifdef USE_MONTH_SIMULATION
+void SimulateMonth(CityContext* city);
+#endif
+#ifdef USE_FAST_FORWARD
+uint8_t FastForward(CityContext* city, uint16_t targetYear, uint8_t targetMonth, uint32_t maxMilliseconds);
+#endif
+void ResetSimulationCaches(CityContext* city);
+#endif
+
+// Call after changing anything about a building that affects its neighbours (type, power, fire, density, traffic)
+inline void UpdateBuildingCaches(Building* building)
+{
+	UpdateIndexedBuilding(building);
+	UpdateBuildingPollution(building);
+	UpdateBuildingCoverage(building);
+	UpdateBuildingFire(building);
+	UpdateBuildingTraffic(building);
+	UpdateZoneSchedule(building);
+}
+
+// Individual simulation steps, exposed so that they can be profiled separately
+void SimulateBuilding(Building* building);
+void CountPopulation(void);
+
+// The population totals in City.state are kept up to date as zones change instead of recounted each
+// month. Call with the change in density, or before a zone stops being one with minus its density
+void AddZonePopulation(Building* building, int populationChange);
+void DoBudget(void);
+bool SpreadFire(Building* building, uint8_t draw);
+
+// One tick of a burning building. draw is passed on to GetSimulationRand
+void SimulateFire(Building* building, uint8_t draw);
+uint8_t GetNumRoadConnections(Building* building);
+bool IsRoadConnected(Building* building);
+int8_t GetLocalInfluence(uint8_t buildingType, uint8_t populationDensity, uint8_t otherType, uint8_t otherPopulationDensity);
+
+#ifdef USE_ROAD_CONNECTION_CACHE
+// Road connection counts are cached on desktop builds. SetConnections invalidates the buildings next to
+// a tile when its road changes, placing or destroying a building invalidates that building
+void InvalidateRoadConnections(Building* building);
+void InvalidateRoadConnections(uint8_t x, uint8_t y);
+
+// Forgets every count and the number of road tiles, for when the whole map may have changed
+void ResetRoadConnections(void);
+#else
+inline void InvalidateRoadConnections(Building* building) {}
+inline void ResetRoadConnections() {}
+#endif
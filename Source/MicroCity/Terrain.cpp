@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include "Terrain.h"
 #include "Game.h"
+#include "City.h"
 #include "Defines.h"
 
 const uint8_t Terrain1Data[] PROGMEM =
@@ -55,7 +56,7 @@ bool IsTerrainClear(int x, int y)
 	int index = (blockY * (MAP_WIDTH / 8) + blockX) * 8 + blockU;
 	uint8_t mask = 1 << blockV;
 
-	const uint8_t* terrainData = GetTerrainData(State.terrainType);
+	const uint8_t* terrainData = GetTerrainData(City.state.terrainType);
 
 	uint8_t blockData = pgm_read_byte(&terrainData[index]);
 
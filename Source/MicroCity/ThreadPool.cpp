@@ -0,0 +1,184 @@
+#include "ThreadPool.h"
+#include "City.h"
+
+#ifdef USE_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each ParallelFor bumps the generation to wake the workers, who take indices from a shared counter
+// until there are none left so uneven tasks still balance out
+class WorkerPool
+{
+public:
+	~WorkerPool()
+	{
+		StopWorkers();
+	}
+
+	void Run(int count, ParallelTask task, void* context)
+	{
+		if (count <= 0)
+			return;
+
+		// A task calling ParallelFor runs the inner loop itself, the workers are all busy with the outer one
+		if (InsideTask || count == 1)
+		{
+			RunInline(count, task, context);
+			return;
+		}
+
+		// Other threads wait their turn, the task and the index counter are shared
+		std::lock_guard<std::mutex> runLock(RunMutex);
+
+		// The pool is only resized when the number of threads asked for changes, workers with nothing
+		// to do find the counter has already run out
+		int numWorkers = (RequestedThreads > 0 ? RequestedThreads : GetHardwareThreads()) - 1;
+
+		if (numWorkers <= 0)
+		{
+			RunInline(count, task, context);
+			return;
+		}
+
+		if ((int)Workers.size() != numWorkers)
+		{
+			StopWorkers();
+			StartWorkers(numWorkers);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Task = task;
+			Context = context;
+			TaskCity = CurrentCity;
+			Count = count;
+			NextIndex.store(0, std::memory_order_relaxed);
+			WorkersRunning = numWorkers;
+			Generation++;
+		}
+		WorkReady.notify_all();
+
+		InsideTask = true;
+		RunTasks();
+		InsideTask = false;
+
+		std::unique_lock<std::mutex> lock(Mutex);
+		WorkDone.wait(lock, [this] { return WorkersRunning == 0; });
+	}
+
+	int RequestedThreads = 0;
+
+	static int GetHardwareThreads()
+	{
+		unsigned int numThreads = std::thread::hardware_concurrency();
+		return numThreads ? (int)numThreads : 1;
+	}
+
+private:
+	static void RunInline(int count, ParallelTask task, void* context)
+	{
+		for (int n = 0; n < count; n++)
+		{
+			task(context, n);
+		}
+	}
+
+	void RunTasks()
+	{
+		for (int n = NextIndex.fetch_add(1); n < Count; n = NextIndex.fetch_add(1))
+		{
+			Task(Context, n);
+		}
+	}
+
+	void WorkerMain()
+	{
+		uint32_t lastGeneration = 0;
+		InsideTask = true;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(Mutex);
+				WorkReady.wait(lock, [&] { return Stopping || Generation != lastGeneration; });
+				if (Stopping)
+					return;
+				lastGeneration = Generation;
+				SetCurrentCity(TaskCity);
+			}
+
+			RunTasks();
+
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (--WorkersRunning == 0)
+				WorkDone.notify_one();
+		}
+	}
+
+	void StartWorkers(int numWorkers)
+	{
+		Stopping = false;
+		Generation = 0;
+		for (int n = 0; n < numWorkers; n++)
+		{
+			Workers.emplace_back(&WorkerPool::WorkerMain, this);
+		}
+	}
+
+	void StopWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Stopping = true;
+		}
+		WorkReady.notify_all();
+
+		for (std::thread& worker : Workers)
+		{
+			worker.join();
+		}
+		Workers.clear();
+	}
+
+	static thread_local bool InsideTask;
+
+	std::vector<std::thread> Workers;
+	std::mutex RunMutex;
+	std::mutex Mutex;
+	std::condition_variable WorkReady;
+	std::condition_variable WorkDone;
+	uint32_t Generation = 0;
+	bool Stopping = false;
+	int WorkersRunning = 0;
+
+	ParallelTask Task = nullptr;
+	void* Context = nullptr;
+	CityContext* TaskCity = nullptr;
+	int Count = 0;
+	std::atomic<int> NextIndex;
+};
+
+thread_local bool WorkerPool::InsideTask = false;
+
+static WorkerPool Pool;
+
+void ParallelFor(int count, ParallelTask task, void* context)
+{
+	Pool.Run(count, task, context);
+}
+
+void SetNumThreads(int numThreads)
+{
+	Pool.RequestedThreads = numThreads;
+}
+
+int GetNumThreads()
+{
+	return Pool.RequestedThreads > 0 ? Pool.RequestedThreads : WorkerPool::GetHardwareThreads();
+}
+
+#endif
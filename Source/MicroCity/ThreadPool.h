@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Defines.h"
+
+#ifdef USE_THREAD_POOL
+
+// A fixed set of worker threads for the desktop builds. The workers are started the first time
+// there is something to run and sleep in between
+
+typedef void (*ParallelTask)(void* context, int index);
+
+// Calls task for every index from 0 to count - 1, spread across the workers and the calling thread.
+// The workers run the tasks on the calling thread's current city. Returns once all of them have
+// finished. Calls from other threads wait for the one in progress, calls from inside a task run every
+// index on that thread
+void ParallelFor(int count, ParallelTask task, void* context);
+
+// Including the calling thread, 0 uses one per hardware thread. Takes effect on the next ParallelFor
+void SetNumThreads(int numThreads);
+int GetNumThreads(void);
+
+#endif
@@ -0,0 +1,120 @@
+#include "Trace.h"
+
+#ifdef ENABLE_TRACING
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+// Each thread gets its own ring buffer so recording a zone never takes a lock. When a buffer fills up
+// the oldest events are overwritten
+#define TRACE_BUFFER_SIZE (1 << 18)
+
+struct TraceEvent
+{
+	const char* name;
+	uint64_t startTime;
+	uint64_t endTime;
+};
+
+struct TraceBuffer
+{
+	TraceEvent events[TRACE_BUFFER_SIZE];
+	std::atomic<uint32_t> numWritten;
+	uint32_t threadId;
+	TraceBuffer* next;
+};
+
+static std::atomic<TraceBuffer*> TraceBufferList(nullptr);
+static std::atomic<uint32_t> NextTraceThreadId(1);
+static thread_local TraceBuffer* ThreadTraceBuffer = nullptr;
+static const std::chrono::steady_clock::time_point TraceEpoch = std::chrono::steady_clock::now();
+
+static uint64_t GetTraceTime()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - TraceEpoch).count();
+}
+
+static TraceBuffer* GetThreadTraceBuffer()
+{
+	if (!ThreadTraceBuffer)
+	{
+		TraceBuffer* buffer = new TraceBuffer;
+		buffer->numWritten.store(0, std::memory_order_relaxed);
+		buffer->threadId = NextTraceThreadId.fetch_add(1, std::memory_order_relaxed);
+
+		// Buffers are never freed so that events from threads which have finished can still be exported
+		buffer->next = TraceBufferList.load(std::memory_order_relaxed);
+		while (!TraceBufferList.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+
+		ThreadTraceBuffer = buffer;
+	}
+
+	return ThreadTraceBuffer;
+}
+
+TraceZone::TraceZone(const char* zoneName)
+	: name(zoneName)
+	, startTime(GetTraceTime())
+{
+}
+
+TraceZone::~TraceZone()
+{
+	TraceBuffer* buffer = GetThreadTraceBuffer();
+	uint32_t index = buffer->numWritten.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[index & (TRACE_BUFFER_SIZE - 1)];
+
+	event.name = name;
+	event.startTime = startTime;
+	event.endTime = GetTraceTime();
+
+	buffer->numWritten.store(index + 1, std::memory_order_release);
+}
+
+bool WriteChromeTrace(const char* fileName)
+{
+	FILE* fs = fopen(fileName, "w");
+
+	if (!fs)
+		return false;
+
+	fprintf(fs, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	bool first = true;
+
+	for (TraceBuffer* buffer = TraceBufferList.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+	{
+		uint32_t numWritten = buffer->numWritten.load(std::memory_order_acquire);
+		uint32_t start = numWritten > TRACE_BUFFER_SIZE ? numWritten - TRACE_BUFFER_SIZE : 0;
+
+		for (uint32_t n = start; n < numWritten; n++)
+		{
+			const TraceEvent& event = buffer->events[n & (TRACE_BUFFER_SIZE - 1)];
+
+			// Timestamps are in microseconds
+			fprintf(fs, "%s\n{\"name\":\"%s\",\"cat\":\"microcity\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",", event.name, buffer->threadId,
+				event.startTime / 1000.0, (event.endTime - event.startTime) / 1000.0);
+			first = false;
+		}
+	}
+
+	fprintf(fs, "\n]}\n");
+
+	bool success = ferror(fs) == 0;
+	fclose(fs);
+	return success;
+}
+
+void ClearTrace()
+{
+	for (TraceBuffer* buffer = TraceBufferList.load(std::memory_order_acquire); buffer; buffer = buffer->next)
+	{
+		buffer->numWritten.store(0, std::memory_order_release);
+	}
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+// Lightweight timing instrumentation for desktop builds. TRACE_ZONE records how long the enclosing
+// scope took into a per thread ring buffer, which can be exported in the Chrome trace_event format
+// and viewed in chrome://tracing or Perfetto. Without ENABLE_TRACING (e.g. on the Arduboy) the
+// macros compile to nothing
+
+#ifdef ENABLE_TRACING
+
+#include <stdint.h>
+
+class TraceZone
+{
+public:
+	// Name must be a string literal as only the pointer is stored
+	explicit TraceZone(const char* name);
+	~TraceZone();
+
+private:
+	const char* name;
+	uint64_t startTime;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+// Writes every event still held in the ring buffers. Other threads should be idle while this runs
+bool WriteChromeTrace(const char* fileName);
+void ClearTrace(void);
+
+#else
+
+#define TRACE_ZONE(name)
+
+#endif
@@ -0,0 +1,312 @@
+#include "City.h"
+#include "Building.h"
+#include "Connectivity.h"
+#include "Draw.h"
+#include "Traffic.h"
+#include "Trace.h"
+
+#ifdef USE_TRAFFIC_FLOW
+
+#ifdef ENABLE_CHECKS
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+// What a building slot is counted as, a job or a number of trips
+#define TRAFFIC_DESTINATION 0x80
+
+#define NO_TRAFFIC_TILE 0xffff
+#define TRAFFIC_UNREACHED 0xffff
+
+// The most road tiles sharing an edge with a 4x4 building
+#define MAX_ROAD_TILES_AROUND 16
+
+enum TrafficPassState
+{
+	TrafficPass_Idle,
+	TrafficPass_Searching,
+	TrafficPass_AddingLoads
+};
+
+static uint8_t GetTrafficRole(Building* building)
+{
+	return IsTrafficDestination(building) ? TRAFFIC_DESTINATION : GetTrafficTrips(building);
+}
+
+static inline bool IsRoadTile(int index)
+{
+	return (City.state.connectionMap[index >> 2] >> (2 * (index & 3))) & RoadMask;
+}
+
+static int GetRoadTilesAround(Building* building, uint16_t* tiles)
+{
+	const BuildingInfo* info = GetBuildingInfo(building->type);
+	uint8_t width = pgm_read_byte(&info->width);
+	uint8_t height = pgm_read_byte(&info->height);
+	int count = 0;
+
+	for (int i = 0; i < width; i++)
+	{
+		int x = building->x + i;
+		if (building->y > 0 && IsRoadTile((building->y - 1) * MAP_WIDTH + x))
+			tiles[count++] = (building->y - 1) * MAP_WIDTH + x;
+		if (building->y + height < MAP_HEIGHT && IsRoadTile((building->y + height) * MAP_WIDTH + x))
+			tiles[count++] = (building->y + height) * MAP_WIDTH + x;
+	}
+	for (int i = 0; i < height; i++)
+	{
+		int y = building->y + i;
+		if (building->x > 0 && IsRoadTile(y * MAP_WIDTH + building->x - 1))
+			tiles[count++] = y * MAP_WIDTH + building->x - 1;
+		if (building->x + width < MAP_WIDTH && IsRoadTile(y * MAP_WIDTH + building->x + width))
+			tiles[count++] = y * MAP_WIDTH + building->x + width;
+	}
+
+	return count;
+}
+
+void UpdateBuildingTraffic(Building* building)
+{
+	uint8_t* role = &City.trafficZones[building - City.state.buildings];
+	uint8_t newRole = GetTrafficRole(building);
+
+	if (*role != newRole)
+	{
+		// Jobs opening or closing change the routes, homes only change how much goes along them
+		if ((*role | newRole) & TRAFFIC_DESTINATION)
+			City.trafficRoutesDirty = true;
+		else
+			City.trafficLoadsDirty = true;
+
+		*role = newRole;
+	}
+}
+
+void InvalidateTrafficRoutes()
+{
+	City.trafficRoutesDirty = true;
+}
+
+static void VisitRoadTile(uint16_t tile, uint16_t nextTile, uint16_t distance)
+{
+	if (City.trafficDistance[tile] == TRAFFIC_UNREACHED && IsRoadTile(tile))
+	{
+		City.trafficDistance[tile] = distance;
+		City.trafficNextTile[tile] = nextTile;
+		City.trafficQueue[City.trafficQueueTail++] = tile;
+	}
+}
+
+static void StartSearch()
+{
+	memset(City.trafficDistance, 0xff, sizeof(City.trafficDistance));
+	City.trafficQueueHead = City.trafficQueueTail = 0;
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.trafficZones[n] == TRAFFIC_DESTINATION)
+		{
+			uint16_t tiles[MAX_ROAD_TILES_AROUND];
+			int count = GetRoadTilesAround(&City.state.buildings[n], tiles);
+
+			for (int i = 0; i < count; i++)
+			{
+				VisitRoadTile(tiles[i], NO_TRAFFIC_TILE, 0);
+			}
+		}
+	}
+
+	City.trafficPassState = TrafficPass_Searching;
+	City.trafficRoutesDirty = false;
+	City.trafficLoadsDirty = false;
+}
+
+// One unit of work for each road tile taken off the queue
+static uint16_t SearchRoads(uint16_t work)
+{
+	while (work && City.trafficQueueHead < City.trafficQueueTail)
+	{
+		uint16_t tile = City.trafficQueue[City.trafficQueueHead++];
+		uint16_t distance = City.trafficDistance[tile] + 1;
+		int x = tile % MAP_WIDTH;
+		int y = tile / MAP_WIDTH;
+
+		if (x > 0)
+			VisitRoadTile(tile - 1, tile, distance);
+		if (x < MAP_WIDTH - 1)
+			VisitRoadTile(tile + 1, tile, distance);
+		if (y > 0)
+			VisitRoadTile(tile - MAP_WIDTH, tile, distance);
+		if (y < MAP_HEIGHT - 1)
+			VisitRoadTile(tile + MAP_WIDTH, tile, distance);
+
+		work--;
+	}
+
+	return work;
+}
+
+// Each home's trips join the roads at whichever tile next to it is closest to a job
+static void StartAddingLoads()
+{
+	memset(City.trafficLoad, 0, sizeof(City.trafficLoad));
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		uint8_t trips = City.trafficZones[n];
+
+		if (trips && trips != TRAFFIC_DESTINATION)
+		{
+			uint16_t tiles[MAX_ROAD_TILES_AROUND];
+			int count = GetRoadTilesAround(&City.state.buildings[n], tiles);
+			uint16_t closestTile = NO_TRAFFIC_TILE;
+			uint16_t closestDistance = TRAFFIC_UNREACHED;
+
+			for (int i = 0; i < count; i++)
+			{
+				if (City.trafficDistance[tiles[i]] < closestDistance)
+				{
+					closestDistance = City.trafficDistance[tiles[i]];
+					closestTile = tiles[i];
+				}
+			}
+
+			if (closestTile != NO_TRAFFIC_TILE)
+			{
+				City.trafficLoad[closestTile] += trips;
+			}
+		}
+	}
+
+	City.trafficAddIndex = City.trafficQueueTail;
+	City.trafficPassState = TrafficPass_AddingLoads;
+	City.trafficLoadsDirty = false;
+}
+
+// Going back through the queue every tile comes before the one it leads on to, so its load is complete
+// by the time it is passed on. One unit of work for each road tile
+static uint16_t AddUpLoads(uint16_t work)
+{
+	while (work && City.trafficAddIndex > 0)
+	{
+		uint16_t tile = City.trafficQueue[--City.trafficAddIndex];
+		uint16_t nextTile = City.trafficNextTile[tile];
+
+		if (nextTile != NO_TRAFFIC_TILE)
+		{
+			City.trafficLoad[nextTile] += City.trafficLoad[tile];
+		}
+
+		work--;
+	}
+
+	return work;
+}
+
+static void PublishLoads()
+{
+	for (int n = 0; n < MAP_WIDTH * MAP_HEIGHT; n++)
+	{
+		uint8_t traffic = City.trafficLoad[n] > 255 ? 255 : (uint8_t)City.trafficLoad[n];
+		bool wasHeavy = City.roadTraffic[n] >= SIM_HEAVY_TRAFFIC_LOAD;
+
+		City.roadTraffic[n] = traffic;
+
+		if (wasHeavy != (traffic >= SIM_HEAVY_TRAFFIC_LOAD))
+		{
+			RefreshTile(n % MAP_WIDTH, n / MAP_WIDTH);
+		}
+	}
+
+	City.trafficPassState = TrafficPass_Idle;
+}
+
+bool SimulateTraffic(uint16_t maxWork)
+{
+	if (City.trafficPassState == TrafficPass_Idle)
+	{
+		if (City.trafficRoutesDirty)
+			StartSearch();
+		else if (City.trafficLoadsDirty)
+			StartAddingLoads();
+		else
+			return true;
+	}
+
+	TRACE_ZONE("SimulateTraffic");
+	uint16_t work = maxWork;
+
+	if (City.trafficPassState == TrafficPass_Searching)
+	{
+		work = SearchRoads(work);
+
+		if (City.trafficQueueHead == City.trafficQueueTail)
+		{
+			StartAddingLoads();
+		}
+	}
+
+	if (City.trafficPassState == TrafficPass_AddingLoads)
+	{
+		work = AddUpLoads(work);
+
+		if (City.trafficAddIndex == 0)
+		{
+			PublishLoads();
+		}
+	}
+
+	return City.trafficPassState == TrafficPass_Idle && !City.trafficRoutesDirty && !City.trafficLoadsDirty;
+}
+
+void ResetTraffic()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		City.trafficZones[n] = GetTrafficRole(&City.state.buildings[n]);
+	}
+
+	memset(City.roadTraffic, 0, sizeof(City.roadTraffic));
+	City.trafficPassState = TrafficPass_Idle;
+	City.trafficRoutesDirty = true;
+
+	while (!SimulateTraffic(TRAFFIC_WORK_UNLIMITED));
+}
+
+uint8_t GetRoadTraffic(uint8_t x, uint8_t y)
+{
+	return City.roadTraffic[y * MAP_WIDTH + x];
+}
+
+uint8_t GetZoneTraffic(Building* building)
+{
+	uint16_t tiles[MAX_ROAD_TILES_AROUND];
+	int count = GetRoadTilesAround(building, tiles);
+	uint8_t traffic = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (City.roadTraffic[tiles[i]] > traffic)
+		{
+			traffic = City.roadTraffic[tiles[i]];
+		}
+	}
+
+	return traffic;
+}
+
+#ifdef ENABLE_CHECKS
+void CheckTraffic()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.trafficZones[n] != GetTrafficRole(&City.state.buildings[n]))
+		{
+			fprintf(stderr, "Traffic doesn't match building %d\n", n);
+			abort();
+		}
+	}
+}
+#endif
+
+#endif
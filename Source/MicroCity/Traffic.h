@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Game.h"
+
+// Commercial and industrial zones are where the jobs are, residential zones send out a trip for each
+// step of population density. Burning zones are closed
+inline bool IsTrafficDestination(Building* building)
+{
+	return (building->type == Commercial || building->type == Industrial) && !building->onFire;
+}
+
+inline uint8_t GetTrafficTrips(Building* building)
+{
+	return building->type == Residential && !building->onFire ? building->populationDensity : 0;
+}
+
+#ifdef USE_TRAFFIC_FLOW
+
+// How many trips have to pass along a road tile for it to count as heavy traffic, a little more than
+// one densely populated block sends out
+#define SIM_HEAVY_TRAFFIC_LOAD 16
+
+// How much of a pass each call to Simulate does. A pass visits every road tile twice, once for the
+// search and once to add up the loads, so even a map covered in roads is done within a month
+#define TRAFFIC_WORK_PER_STEP 48
+#define TRAFFIC_WORK_UNLIMITED 0xffff
+
+// Traffic flow builds route every home's trips along the roads to the closest job with a breadth first
+// search from the road tiles next to commercial and industrial zones, and count the trips passing
+// along each road tile. The search is only redone when the roads or the jobs change, when only the
+// number of trips has changed the loads are added up again along the routes already found. Either
+// costs a fixed amount of work per road tile plus a look at the tiles around each zone, and is done
+// TRAFFIC_WORK_PER_STEP at a time. The loads from the last finished pass are what the zones and
+// the map see. UpdateBuildingTraffic must be called whenever anything the checks above depend on changes
+void UpdateBuildingTraffic(Building* building);
+void InvalidateTrafficRoutes(void);
+void ResetTraffic(void);
+
+// Carries on with the pass in progress, starting a new one if anything has changed since the last.
+// Returns true once there is nothing left to do
+bool SimulateTraffic(uint16_t maxWork);
+
+// Trips along a road tile, saturating at 255
+uint8_t GetRoadTraffic(uint8_t x, uint8_t y);
+
+// The busiest road tile next to a building
+uint8_t GetZoneTraffic(Building* building);
+
+#ifdef ENABLE_CHECKS
+// Aborts if what the zones were last counted as doesn't match the buildings
+void CheckTraffic(void);
+#endif
+
+#else
+
+inline void UpdateBuildingTraffic(Building* building) {}
+inline void ResetTraffic() {}
+
+#endif
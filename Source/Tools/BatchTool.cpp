@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BenchUtil.h"
+#include "Game.h"
+#include "City.h"
+#include "Interface.h"
+#include "Simulation.h"
+#include "ThreadPool.h"
+#include "NullPlatform.h"
+
+#if defined(USE_CITY_CONTEXT) && defined(USE_THREAD_POOL) && defined(USE_FAST_FORWARD)
+
+// Runs a list of saved cities side by side, each in its own CityContext, and writes out how every city
+// is doing at the end of each simulated year. The manifest has one city per line: the save file
+// (relative to the manifest) followed by any overrides as name=value pairs
+//
+//   # Lines starting with # are ignored
+//   grid_1.cty tax=12 years=20 label=grid_high_tax
+//   grid_1.cty tax=4 seed=1234
+//
+// Overrides: tax (tax rate), money, seed (random seed, 0 for the LFSR), years, label
+
+struct BatchCity
+{
+	std::string fileName;
+	std::string label;
+	int years;
+	int taxRate;			// -1 to keep the saved value
+	bool hasMoney;
+	int32_t money;
+	bool hasSeed;
+	uint32_t seed;
+};
+
+struct YearMetrics
+{
+	uint16_t year;
+	uint16_t residential;
+	uint16_t commercial;
+	uint16_t industrial;
+	int32_t money;
+	int32_t taxesCollected;		// From the last budget
+	int fires;					// Fires started during the year
+	int buildings;
+	int powered;
+};
+
+struct BatchRun
+{
+	std::vector<BatchCity> cities;
+	FILE* csvFile;
+	FILE* jsonFile;
+	std::mutex outputMutex;
+	int numFailed;
+};
+
+static void PrintUsage()
+{
+	printf("Usage: microcity_batch MANIFEST [options]\n");
+	printf("  --years N        Years to simulate each city for, unless overridden (default 10)\n");
+	printf("  --threads N      Number of threads (default one per hardware thread)\n");
+	printf("  --csv FILE       Write the yearly metrics as CSV ('-' for stdout)\n");
+	printf("  --jsonl FILE     Write the yearly metrics as one JSON object per line ('-' for stdout)\n");
+	printf("Without --csv or --jsonl the CSV is written to stdout\n");
+}
+
+static std::string GetDirectory(const char* fileName)
+{
+	const char* slash = strrchr(fileName, '/');
+#ifdef _WIN32
+	const char* backslash = strrchr(fileName, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+	return slash ? std::string(fileName, slash - fileName + 1) : std::string();
+}
+
+static bool ParseOverride(BatchCity* city, const char* name, const char* value)
+{
+	if (!strcmp(name, "tax"))
+	{
+		city->taxRate = atoi(value);
+		return city->taxRate >= 0 && city->taxRate <= 99;
+	}
+	if (!strcmp(name, "money"))
+	{
+		city->hasMoney = true;
+		city->money = (int32_t)strtol(value, nullptr, 10);
+		return true;
+	}
+	if (!strcmp(name, "seed"))
+	{
+		city->hasSeed = true;
+		city->seed = (uint32_t)strtoul(value, nullptr, 10);
+		return true;
+	}
+	if (!strcmp(name, "years"))
+	{
+		city->years = atoi(value);
+		return city->years >= 0;
+	}
+	if (!strcmp(name, "label"))
+	{
+		city->label = value;
+		return true;
+	}
+	return false;
+}
+
+static bool LoadManifest(const char* fileName, int defaultYears, std::vector<BatchCity>& cities)
+{
+	FILE* fs = fopen(fileName, "r");
+	if (!fs)
+	{
+		fprintf(stderr, "Could not open manifest %s\n", fileName);
+		return false;
+	}
+
+	std::string directory = GetDirectory(fileName);
+	char line[1024];
+	int lineNumber = 0;
+	bool valid = true;
+
+	while (fgets(line, sizeof(line), fs))
+	{
+		lineNumber++;
+		char* token = strtok(line, " \t\r\n");
+		if (!token || token[0] == '#')
+			continue;
+
+		BatchCity city;
+		city.fileName = (token[0] == '/' || directory.empty()) ? std::string(token) : directory + token;
+		city.label = token;
+		city.years = defaultYears;
+		city.taxRate = -1;
+		city.hasMoney = false;
+		city.money = 0;
+		city.hasSeed = false;
+		city.seed = 0;
+
+		while ((token = strtok(nullptr, " \t\r\n")) != nullptr)
+		{
+			char* equals = strchr(token, '=');
+			if (equals)
+				*equals = '\0';
+
+			if (!equals || !ParseOverride(&city, token, equals + 1))
+			{
+				fprintf(stderr, "%s:%d: bad override '%s'\n", fileName, lineNumber, token);
+				valid = false;
+			}
+		}
+
+		cities.push_back(city);
+	}
+
+	fclose(fs);
+	return valid;
+}
+
+static void GetYearMetrics(YearMetrics* metrics, int fires)
+{
+	metrics->year = City.state.year + 1900;
+	metrics->residential = City.state.residentialPopulation;
+	metrics->commercial = City.state.commercialPopulation;
+	metrics->industrial = City.state.industrialPopulation;
+	metrics->money = City.state.money;
+	metrics->taxesCollected = City.state.taxesCollected;
+	metrics->fires = fires;
+	metrics->buildings = 0;
+	metrics->powered = 0;
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type && !IsRubble(building->type))
+		{
+			metrics->buildings++;
+			if (building->hasPower)
+				metrics->powered++;
+		}
+	}
+}
+
+static void WriteYearMetrics(BatchRun* run, int index, const YearMetrics* metrics)
+{
+	const BatchCity* city = &run->cities[index];
+	double powerCoverage = metrics->buildings ? (double)metrics->powered / metrics->buildings : 0.0;
+
+	std::lock_guard<std::mutex> lock(run->outputMutex);
+
+	if (run->csvFile)
+	{
+		fprintf(run->csvFile, "%d,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.3f\n",
+			index, city->label.c_str(), metrics->year, metrics->residential, metrics->commercial, metrics->industrial,
+			(int)metrics->money, (int)metrics->taxesCollected, metrics->fires, metrics->buildings, metrics->powered, powerCoverage);
+	}
+	if (run->jsonFile)
+	{
+		fprintf(run->jsonFile, "{\"city\":%d,\"label\":\"%s\",\"year\":%d,\"residential\":%d,\"commercial\":%d,\"industrial\":%d,"
+			"\"money\":%d,\"taxes\":%d,\"fires\":%d,\"buildings\":%d,\"powered\":%d,\"powerCoverage\":%.3f}\n",
+			index, EscapeJson(city->label).c_str(), metrics->year, metrics->residential, metrics->commercial, metrics->industrial,
+			(int)metrics->money, (int)metrics->taxesCollected, metrics->fires, metrics->buildings, metrics->powered, powerCoverage);
+	}
+}
+
+static bool SimulateBatchCity(BatchRun* run, int index)
+{
+	const BatchCity* city = &run->cities[index];
+
+	if (!LoadCityFile(city->fileName.c_str()))
+	{
+		fprintf(stderr, "Could not load city from %s\n", city->fileName.c_str());
+		return false;
+	}
+
+	if (city->taxRate >= 0)
+		City.state.taxRate = (uint8_t)city->taxRate;
+	if (city->hasMoney)
+		City.state.money = city->money;
+#ifdef USE_COUNTER_RNG
+	if (city->hasSeed)
+		City.state.randomSeed = city->seed;
+#endif
+
+	City.uiState.state = InGame;
+	ResetSimulationCaches();
+
+	for (int year = 0; year < city->years; year++)
+	{
+		uint16_t targetYear = City.state.year + 1;
+		uint8_t targetMonth = City.state.month;
+		uint8_t result;
+		int fires = 0;
+
+		// Fires and budgets stop the fast forward the same way they would stop the player
+		while ((result = FastForward(targetYear, targetMonth, 0)) != FastForward_ReachedDate)
+		{
+			if (result == FastForward_Disaster)
+				fires++;
+			City.uiState.state = InGame;
+		}
+
+		YearMetrics metrics;
+		GetYearMetrics(&metrics, fires);
+		WriteYearMetrics(run, index, &metrics);
+	}
+
+	return true;
+}
+
+// Each task simulates one city from start to finish on a context of its own, the pool hands out the
+// next city to whichever thread is free so long and short runs balance out
+static void RunBatchCity(void* context, int index)
+{
+	BatchRun* run = (BatchRun*)context;
+	CityContext* city = CreateCity(DEFAULT_CITY_SEED);
+	bool simulated;
+
+	{
+		CurrentCityScope scope(city);
+		simulated = SimulateBatchCity(run, index);
+	}
+
+	DestroyCity(city);
+
+	if (!simulated)
+	{
+		std::lock_guard<std::mutex> lock(run->outputMutex);
+		run->numFailed++;
+	}
+}
+
+static FILE* OpenOutput(const char* fileName)
+{
+	if (!strcmp(fileName, "-"))
+		return stdout;
+
+	FILE* fs = fopen(fileName, "w");
+	if (!fs)
+		fprintf(stderr, "Could not open %s for writing\n", fileName);
+	return fs;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* manifestFileName = nullptr;
+	const char* csvFileName = nullptr;
+	const char* jsonFileName = nullptr;
+	int defaultYears = 10;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--years") && hasValue)
+			defaultYears = atoi(argv[++n]);
+		else if (!strcmp(argv[n], "--threads") && hasValue)
+			SetNumThreads(atoi(argv[++n]));
+		else if (!strcmp(argv[n], "--csv") && hasValue)
+			csvFileName = argv[++n];
+		else if (!strcmp(argv[n], "--jsonl") && hasValue)
+			jsonFileName = argv[++n];
+		else if (argv[n][0] != '-' && !manifestFileName)
+			manifestFileName = argv[n];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (!manifestFileName)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	BatchRun run;
+	run.csvFile = nullptr;
+	run.jsonFile = nullptr;
+	run.numFailed = 0;
+
+	if (!LoadManifest(manifestFileName, defaultYears, run.cities))
+		return 1;
+
+	if (!csvFileName && !jsonFileName)
+		csvFileName = "-";
+	if (csvFileName && !(run.csvFile = OpenOutput(csvFileName)))
+		return 1;
+	if (jsonFileName && !(run.jsonFile = OpenOutput(jsonFileName)))
+		return 1;
+
+	if (run.csvFile)
+		fprintf(run.csvFile, "city,label,year,residential,commercial,industrial,money,taxes,fires,buildings,powered,power_coverage\n");
+
+	auto startTime = std::chrono::steady_clock::now();
+	ParallelFor((int)run.cities.size(), RunBatchCity, &run);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	fprintf(stderr, "Simulated %d cities in %.3f s on %d threads\n", (int)run.cities.size() - run.numFailed, seconds, GetNumThreads());
+
+	if (run.csvFile && run.csvFile != stdout)
+		fclose(run.csvFile);
+	if (run.jsonFile && run.jsonFile != stdout)
+		fclose(run.jsonFile);
+
+	return run.numFailed ? 1 : 0;
+}
+
+#else
+
+int main(int argc, char* argv[])
+{
+	fprintf(stderr, "microcity_batch needs a build with city contexts, the thread pool and fast forwarding\n");
+	return 1;
+}
+
+#endif
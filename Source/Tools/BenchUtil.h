@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Shared timing and reporting helpers for the benchmark tools
+
+typedef std::chrono::steady_clock BenchClock;
+
+inline double ElapsedNs(BenchClock::time_point start, BenchClock::time_point end)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+struct BenchResult
+{
+	std::string group;		// e.g. fixture name
+	std::string name;		// e.g. phase name
+	size_t count;
+	double mean;
+	double min;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+};
+
+inline double Percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0;
+
+	size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+inline BenchResult SummariseSamples(const std::string& group, const std::string& name, std::vector<double> samples)
+{
+	BenchResult result;
+	result.group = group;
+	result.name = name;
+	result.count = samples.size();
+	result.mean = result.min = result.p50 = result.p90 = result.p99 = result.max = 0;
+
+	if (samples.empty())
+		return result;
+
+	std::sort(samples.begin(), samples.end());
+
+	double total = 0;
+	for (double sample : samples)
+		total += sample;
+
+	result.mean = total / samples.size();
+	result.min = samples.front();
+	result.p50 = Percentile(samples, 0.5);
+	result.p90 = Percentile(samples, 0.9);
+	result.p99 = Percentile(samples, 0.99);
+	result.max = samples.back();
+	return result;
+}
+
+inline void PrintResultTable(const std::vector<BenchResult>& results, const char* unit)
+{
+	printf("%-14s %-28s %8s %11s %11s %11s %11s %11s\n", "group", "name", "count", "mean", "p50", "p90", "p99", "max");
+	printf("%-14s %-28s %8s %11s %11s %11s %11s %11s\n", "", "", "", unit, unit, unit, unit, unit);
+
+	for (const BenchResult& result : results)
+	{
+		printf("%-14s %-28s %8zu %11.1f %11.1f %11.1f %11.1f %11.1f\n", result.group.c_str(), result.name.c_str(),
+			result.count, result.mean, result.p50, result.p90, result.p99, result.max);
+	}
+}
+
+// Quotes, backslashes and control characters escaped for use inside a JSON string
+inline std::string EscapeJson(const std::string& text)
+{
+	std::string escaped;
+
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+			escaped += code;
+		}
+		else
+		{
+			escaped += c;
+		}
+	}
+
+	return escaped;
+}
+
+inline bool WriteResultJson(const char* fileName, const char* benchmarkName, const char* unit, const std::vector<BenchResult>& results)
+{
+	FILE* fs = fopen(fileName, "w");
+
+	if (!fs)
+		return false;
+
+	fprintf(fs, "{\n  \"benchmark\": \"%s\",\n  \"unit\": \"%s\",\n  \"results\": [\n", EscapeJson(benchmarkName).c_str(), EscapeJson(unit).c_str());
+
+	for (size_t n = 0; n < results.size(); n++)
+	{
+		const BenchResult& result = results[n];
+		fprintf(fs, "    { \"group\": \"%s\", \"name\": \"%s\", \"count\": %zu, \"mean\": %.1f, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f }%s\n",
+			EscapeJson(result.group).c_str(), EscapeJson(result.name).c_str(), result.count, result.mean, result.min,
+			result.p50, result.p90, result.p99, result.max, n + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(fs, "  ]\n}\n");
+	fclose(fs);
+	return true;
+}
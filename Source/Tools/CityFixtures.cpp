@@ -0,0 +1,184 @@
+#include "Game.h"
+#include "City.h"
+#include "Draw.h"
+#include "Interface.h"
+#include "Simulation.h"
+#include "CityFixtures.h"
+
+// Buildings are laid out in bands 3 tiles high with a road underneath each band.
+// The top band is 4 tiles high to leave space for power plants
+#define FIXTURE_FIRST_BAND_Y 5
+#define FIXTURE_BAND_SPACING 4
+#define FIXTURE_POWER_CROSSING_SPACING 6
+
+static uint32_t FixtureRandState;
+
+static uint8_t FixtureRand()
+{
+	FixtureRandState = FixtureRandState * 1103515245u + 12345u;
+	return (uint8_t)(FixtureRandState >> 16);
+}
+
+const char* GetFixtureName(int fixture)
+{
+	switch (fixture)
+	{
+	case Fixture_Empty: return "empty";
+	case Fixture_Sparse: return "sparse";
+	case Fixture_Full: return "full";
+	case Fixture_PowerMaze: return "powermaze";
+	default: return "unknown";
+	}
+}
+
+static int CountBuildings()
+{
+	int count = 0;
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.state.buildings[n].type)
+			count++;
+	}
+	return count;
+}
+
+static uint8_t PickZoneType(int index)
+{
+	// Mostly zones with a sprinkling of services
+	static const uint8_t ZonePattern[] =
+	{
+		Residential, Residential, Commercial, Industrial, Residential, Commercial,
+		Residential, PoliceDept, Residential, Industrial, Commercial, Park,
+		Residential, Residential, FireDept, Commercial, Industrial, Residential
+	};
+	return ZonePattern[index % sizeof(ZonePattern)];
+}
+
+static void PlaceRoadRow(uint8_t y, bool withPowerCrossings)
+{
+	for (int x = 0; x < MAP_WIDTH; x++)
+	{
+		if (IsTerrainClear(x, y))
+		{
+			bool crossing = withPowerCrossings && (x % FIXTURE_POWER_CROSSING_SPACING) == 1;
+			SetConnections(x, y, crossing ? RoadMask | PowerlineMask : RoadMask);
+		}
+	}
+}
+
+// Fill the bands with 3x3 buildings, placing each candidate with the given chance out of 256
+static void FillBands(int maxBuildings, int placeChance)
+{
+	int zoneIndex = 0;
+
+	for (int bandY = FIXTURE_FIRST_BAND_Y; bandY + 3 < MAP_HEIGHT; bandY += FIXTURE_BAND_SPACING)
+	{
+		PlaceRoadRow(bandY - 1, true);
+		PlaceRoadRow(bandY + 3, true);
+
+		for (int x = 0; x + 3 <= MAP_WIDTH; x += 3)
+		{
+			if (CountBuildings() >= maxBuildings)
+				return;
+
+			if (FixtureRand() >= placeChance)
+				continue;
+
+			uint8_t type = PickZoneType(zoneIndex);
+			if (CanPlaceBuilding(type, x, bandY) && PlaceBuilding(type, x, bandY))
+			{
+				zoneIndex++;
+			}
+		}
+	}
+}
+
+static void PlacePowerplants(int count)
+{
+	for (int x = 0; x + 4 <= MAP_WIDTH && count > 0; x += 4)
+	{
+		if (CanPlaceBuilding(Powerplant, x, 0) && PlaceBuilding(Powerplant, x, 0))
+		{
+			count--;
+		}
+	}
+}
+
+static void BuildPowerMaze()
+{
+	PlaceBuilding(Powerplant, 0, 0);
+
+	// Snake a power line back and forth across the map, ignoring terrain
+	uint8_t lastRow = 0;
+	bool leftToRight = true;
+
+	for (int y = 5; y < MAP_HEIGHT - 5; y += 2)
+	{
+		for (int x = 0; x < MAP_WIDTH; x++)
+		{
+			SetConnections(x, y, PowerlineMask);
+		}
+
+		// Join to the previous row (or the power plant) at alternating ends
+		SetConnections(leftToRight ? 0 : MAP_WIDTH - 1, y - 1, PowerlineMask);
+		leftToRight = !leftToRight;
+		lastRow = y;
+	}
+
+	// Buildings fed from the end of the maze
+	uint8_t bandY = lastRow + 2;
+	PlaceRoadRow(bandY + 3, false);
+	for (int x = 0; x + 3 <= MAP_WIDTH; x += 3)
+	{
+		uint8_t type = PickZoneType(x / 3);
+		if (CanPlaceBuilding(type, x, bandY))
+		{
+			PlaceBuilding(type, x, bandY);
+		}
+	}
+	SetConnections(leftToRight ? 0 : MAP_WIDTH - 1, lastRow + 1, PowerlineMask);
+}
+
+static void RandomiseDensities()
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type == Residential || building->type == Commercial || building->type == Industrial)
+		{
+			building->populationDensity = FixtureRand() & MAX_POPULATION_DENSITY;
+			building->heavyTraffic = building->populationDensity > 12;
+		}
+	}
+}
+
+void BuildFixture(int fixture)
+{
+	InitGame();
+	City.uiState.state = InGame;
+	City.state.terrainType = 0;
+	FixtureRandState = 0x1234 + fixture;
+
+	switch (fixture)
+	{
+	case Fixture_Empty:
+		break;
+	case Fixture_Sparse:
+		PlacePowerplants(1);
+		FillBands(20, 64);
+		break;
+	case Fixture_Full:
+		PlacePowerplants(3);
+		FillBands(MAX_BUILDINGS, 256);
+		break;
+	case Fixture_PowerMaze:
+		BuildPowerMaze();
+		break;
+	}
+
+	RandomiseDensities();
+	CalculatePowerConnectivity();
+	CountPopulation();
+	ResetVisibleTileCache();
+}
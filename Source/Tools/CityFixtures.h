@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed cities used by the benchmark tools. Each fixture is built from scratch
+// into City.state with the normal placement functions so it is always the same
+
+enum CityFixture
+{
+	Fixture_Empty,
+	Fixture_Sparse,
+	Fixture_Full,			// All MAX_BUILDINGS slots in use
+	Fixture_PowerMaze,		// Long snaking power lines between the power plant and the buildings
+	Num_Fixtures
+};
+
+const char* GetFixtureName(int fixture);
+void BuildFixture(int fixture);
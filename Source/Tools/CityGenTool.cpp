@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "Game.h"
+#include "City.h"
+#include "NullPlatform.h"
+#include "CityGenerator.h"
+
+// Writes a reproducible corpus of generated cities as standard save files
+
+static void PrintUsage()
+{
+	printf("Usage: microcity_citygen [options]\n");
+	printf("  --layout NAME    grid, powersnake, traffic, burning or all (default all)\n");
+	printf("  --seed S         Seed of the first city (default 1)\n");
+	printf("  --count N        Number of cities per layout, seeds increase by one (default 1)\n");
+	printf("  --terrain N      Terrain type (0-%d, default 0)\n", NUM_TERRAIN_TYPES - 1);
+	printf("  --buildings N    Maximum number of buildings (default %d)\n", MAX_BUILDINGS);
+	printf("  --age MONTHS     Simulate the city for this many months after generating it\n");
+	printf("  --out DIR        Directory to write the save files to (default .)\n");
+}
+
+static void PrintCitySummary(const char* fileName)
+{
+	int numBuildings = 0, numPowered = 0, numOnFire = 0, numHeavyTraffic = 0;
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type && !IsRubble(building->type))
+		{
+			numBuildings++;
+			if (building->hasPower)
+				numPowered++;
+			if (building->onFire)
+				numOnFire++;
+			if (building->heavyTraffic)
+				numHeavyTraffic++;
+		}
+	}
+
+	printf("%s: %d buildings (%d powered, %d on fire, %d heavy traffic), population %d/%d/%d\n",
+		fileName, numBuildings, numPowered, numOnFire, numHeavyTraffic,
+		City.state.residentialPopulation, City.state.commercialPopulation, City.state.industrialPopulation);
+}
+
+int main(int argc, char* argv[])
+{
+	CityGenParams params;
+	InitCityGenParams(&params);
+
+	int onlyLayout = -1;
+	int count = 1;
+	std::string outDir = ".";
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--layout") && hasValue)
+		{
+			n++;
+			if (strcmp(argv[n], "all"))
+			{
+				onlyLayout = FindLayout(argv[n]);
+				if (onlyLayout == -1)
+				{
+					PrintUsage();
+					return 1;
+				}
+			}
+		}
+		else if (!strcmp(argv[n], "--seed") && hasValue)
+			params.seed = (uint32_t)strtoul(argv[++n], nullptr, 10);
+		else if (!strcmp(argv[n], "--count") && hasValue)
+			count = atoi(argv[++n]);
+		else if (!strcmp(argv[n], "--terrain") && hasValue)
+			params.terrainType = (uint8_t)(atoi(argv[++n]) % NUM_TERRAIN_TYPES);
+		else if (!strcmp(argv[n], "--buildings") && hasValue)
+		{
+			int maxBuildings = atoi(argv[++n]);
+			params.maxBuildings = (uint8_t)(maxBuildings < 0 ? 0 : maxBuildings > MAX_BUILDINGS ? MAX_BUILDINGS : maxBuildings);
+		}
+		else if (!strcmp(argv[n], "--age") && hasValue)
+			params.ageMonths = (uint16_t)atoi(argv[++n]);
+		else if (!strcmp(argv[n], "--out") && hasValue)
+			outDir = argv[++n];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	uint32_t firstSeed = params.seed;
+
+	for (int layout = 0; layout < Num_Layouts; layout++)
+	{
+		if (onlyLayout != -1 && onlyLayout != layout)
+			continue;
+
+		for (int n = 0; n < count; n++)
+		{
+			params.layout = (uint8_t)layout;
+			params.seed = firstSeed + n;
+			GenerateCity(&params);
+
+			std::string fileName = outDir + "/" + GetLayoutName(layout) + "_" + std::to_string(params.seed) + ".cty";
+			SetSaveFileName(fileName.c_str());
+			SaveCity();
+			PrintCitySummary(fileName.c_str());
+		}
+	}
+
+	return 0;
+}
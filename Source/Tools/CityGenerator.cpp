@@ -0,0 +1,321 @@
+#include <string.h>
+#include "Game.h"
+#include "City.h"
+#include "Draw.h"
+#include "Interface.h"
+#include "Simulation.h"
+#include "CityGenerator.h"
+
+// Roads every GRID_SPACING tiles leave 6x6 blocks, each of which fits four 3x3 lots
+// or a 4x4 building
+#define GRID_SPACING 7
+#define SIMULATION_STEPS_PER_MONTH (MAX_BUILDINGS + 3)
+
+static uint32_t GenRandState;
+
+static uint32_t GenRand()
+{
+	// xorshift32
+	GenRandState ^= GenRandState << 13;
+	GenRandState ^= GenRandState >> 17;
+	GenRandState ^= GenRandState << 5;
+	return GenRandState;
+}
+
+static uint32_t GenRandRange(uint32_t range)
+{
+	return GenRand() % range;
+}
+
+const char* GetLayoutName(uint8_t layout)
+{
+	switch (layout)
+	{
+	case Layout_Grid: return "grid";
+	case Layout_PowerSnake: return "powersnake";
+	case Layout_Traffic: return "traffic";
+	case Layout_Burning: return "burning";
+	default: return "unknown";
+	}
+}
+
+int FindLayout(const char* name)
+{
+	for (int layout = 0; layout < Num_Layouts; layout++)
+	{
+		if (!strcmp(name, GetLayoutName(layout)))
+			return layout;
+	}
+	return -1;
+}
+
+void InitCityGenParams(CityGenParams* params)
+{
+	params->seed = 1;
+	params->layout = Layout_Grid;
+	params->terrainType = 0;
+	params->maxBuildings = MAX_BUILDINGS;
+	params->ageMonths = 0;
+}
+
+static int CountBuildings()
+{
+	int count = 0;
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.state.buildings[n].type)
+			count++;
+	}
+	return count;
+}
+
+// Same rules as placing a road or power line from the interface
+static bool PlaceConnection(int x, int y, uint8_t mask)
+{
+	if (x < 0 || y < 0 || x >= MAP_WIDTH || y >= MAP_HEIGHT)
+		return false;
+
+	Building* building = GetBuilding(x, y);
+	if (building && !IsRubble(building->type))
+		return false;
+
+	uint8_t currentConnections = GetConnections(x, y);
+	if (currentConnections & mask)
+		return true;
+
+	if (!IsTerrainClear(x, y) && (currentConnections != 0 || !IsSuitableForBridgedTile(x, y, mask)))
+		return false;
+
+	SetConnections(x, y, currentConnections | mask);
+	return true;
+}
+
+static bool TryPlaceBuilding(uint8_t type, int x, int y, uint8_t maxBuildings)
+{
+	if (CountBuildings() >= maxBuildings)
+		return false;
+
+	return CanPlaceBuilding(type, x, y) && PlaceBuilding(type, x, y);
+}
+
+static uint8_t PickZoneType(bool servicesAllowed)
+{
+	uint32_t roll = GenRandRange(100);
+
+	if (roll < 40)
+		return Residential;
+	if (roll < 60)
+		return Commercial;
+	if (roll < 80)
+		return Industrial;
+	if (!servicesAllowed)
+		return Residential;
+	if (roll < 88)
+		return Park;
+	if (roll < 94)
+		return PoliceDept;
+	return FireDept;
+}
+
+static void BuildRoadGrid()
+{
+	for (int y = 0; y < MAP_HEIGHT; y++)
+	{
+		for (int x = 0; x < MAP_WIDTH; x++)
+		{
+			if (x % GRID_SPACING == 0 || y % GRID_SPACING == 0)
+			{
+				PlaceConnection(x, y, RoadMask);
+			}
+		}
+	}
+}
+
+// Power crosses the roads between neighbouring blocks so whole neighbourhoods are connected
+static void BuildPowerCrossings(uint8_t chance)
+{
+	for (int y = GRID_SPACING; y < MAP_HEIGHT; y += GRID_SPACING)
+	{
+		for (int x = 1; x < MAP_WIDTH; x++)
+		{
+			if (x % GRID_SPACING != 0 && GenRandRange(256) < chance && (GetConnections(x, y) & RoadMask))
+			{
+				SetConnections(x, y, RoadMask | PowerlineMask);
+			}
+		}
+	}
+	for (int x = GRID_SPACING; x < MAP_WIDTH; x += GRID_SPACING)
+	{
+		for (int y = 1; y < MAP_HEIGHT; y++)
+		{
+			if (y % GRID_SPACING != 0 && GenRandRange(256) < chance && (GetConnections(x, y) & RoadMask))
+			{
+				SetConnections(x, y, RoadMask | PowerlineMask);
+			}
+		}
+	}
+}
+
+static void FillBlocks(uint8_t maxBuildings, uint8_t numPowerplants, bool allowStadiums)
+{
+	// Visit the blocks in a random order so the buildings aren't all clustered in the top left
+	uint8_t blockOrder[(MAP_WIDTH / GRID_SPACING + 1) * (MAP_HEIGHT / GRID_SPACING + 1)];
+	uint8_t blocksX = (MAP_WIDTH + GRID_SPACING - 1) / GRID_SPACING;
+	uint8_t blocksY = (MAP_HEIGHT + GRID_SPACING - 1) / GRID_SPACING;
+	uint8_t numBlocks = blocksX * blocksY;
+
+	for (uint8_t n = 0; n < numBlocks; n++)
+	{
+		blockOrder[n] = n;
+	}
+	for (uint8_t n = numBlocks - 1; n > 0; n--)
+	{
+		uint8_t other = GenRandRange(n + 1);
+		uint8_t temp = blockOrder[n];
+		blockOrder[n] = blockOrder[other];
+		blockOrder[other] = temp;
+	}
+
+	for (uint8_t n = 0; n < numBlocks; n++)
+	{
+		int blockX = (blockOrder[n] % blocksX) * GRID_SPACING + 1;
+		int blockY = (blockOrder[n] / blocksX) * GRID_SPACING + 1;
+
+		if (numPowerplants > 0 && TryPlaceBuilding(Powerplant, blockX, blockY, maxBuildings))
+		{
+			numPowerplants--;
+			continue;
+		}
+
+		if (allowStadiums && GenRandRange(16) == 0 && TryPlaceBuilding(Stadium, blockX + 1, blockY + 1, maxBuildings))
+		{
+			continue;
+		}
+
+		for (int lot = 0; lot < 4; lot++)
+		{
+			int x = blockX + (lot & 1) * 3;
+			int y = blockY + (lot >> 1) * 3;
+			TryPlaceBuilding(PickZoneType(true), x, y, maxBuildings);
+		}
+	}
+}
+
+// Snakes a power line back and forth across the whole map and returns the row it finished on
+static int BuildPowerSnake()
+{
+	PlaceBuilding(Powerplant, 0, 0);
+
+	bool leftToRight = true;
+	int lastRow = 0;
+
+	for (int y = 5; y < MAP_HEIGHT - 6; y += 2)
+	{
+		// Join to the previous row (or the power plant) at alternating ends
+		PlaceConnection(leftToRight ? 0 : MAP_WIDTH - 1, y - 1, PowerlineMask);
+
+		for (int i = 0; i < MAP_WIDTH; i++)
+		{
+			PlaceConnection(leftToRight ? i : MAP_WIDTH - 1 - i, y, PowerlineMask);
+		}
+
+		leftToRight = !leftToRight;
+		lastRow = y;
+	}
+
+	PlaceConnection(leftToRight ? 0 : MAP_WIDTH - 1, lastRow + 1, PowerlineMask);
+	return lastRow;
+}
+
+static void FillBelowSnake(int lastRow, uint8_t maxBuildings)
+{
+	int bandY = lastRow + 2;
+
+	for (int x = 0; x < MAP_WIDTH; x++)
+	{
+		PlaceConnection(x, bandY + 3, RoadMask);
+	}
+
+	for (int x = 0; x + 3 <= MAP_WIDTH; x += 3)
+	{
+		TryPlaceBuilding(PickZoneType(false), x, bandY, maxBuildings);
+	}
+}
+
+static void SetDensities(uint8_t minDensity)
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type == Residential || building->type == Commercial || building->type == Industrial)
+		{
+			building->populationDensity = minDensity + GenRandRange(MAX_POPULATION_DENSITY + 1 - minDensity);
+			building->heavyTraffic = building->populationDensity > 12;
+		}
+	}
+}
+
+static void StartFires(uint8_t chance)
+{
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (building->type && building->type != Park && !IsRubble(building->type) && GenRandRange(256) < chance)
+		{
+			building->onFire = 1 + GenRandRange(BUILDING_MAX_FIRE_COUNTER);
+		}
+	}
+}
+
+void GenerateCity(const CityGenParams* params)
+{
+	InitGame();
+	SetTerrainType(params->terrainType);
+	GenRandState = params->seed ? params->seed : 1;
+
+	switch (params->layout)
+	{
+	case Layout_Grid:
+		BuildRoadGrid();
+		BuildPowerCrossings(64);
+		FillBlocks(params->maxBuildings, 2, true);
+		SetDensities(0);
+		break;
+	case Layout_PowerSnake:
+		FillBelowSnake(BuildPowerSnake(), params->maxBuildings);
+		SetDensities(0);
+		break;
+	case Layout_Traffic:
+		BuildRoadGrid();
+		BuildPowerCrossings(96);
+		FillBlocks(params->maxBuildings, 3, false);
+		SetDensities(11);
+		break;
+	case Layout_Burning:
+		BuildRoadGrid();
+		BuildPowerCrossings(64);
+		FillBlocks(params->maxBuildings, 2, true);
+		SetDensities(0);
+		StartFires(48);
+		break;
+	}
+
+	CalculatePowerConnectivity();
+	CountPopulation();
+
+	// Let the city settle so that densities and power reflect the simulation rules
+	SetRandState((uint16_t)(GenRand() | 1));
+#ifdef USE_COUNTER_RNG
+	City.state.randomSeed = GenRand();
+#endif
+	for (uint32_t n = 0; n < (uint32_t)params->ageMonths * SIMULATION_STEPS_PER_MONTH; n++)
+	{
+		Simulate();
+	}
+
+	City.uiState.state = InGame;
+	FocusTile(MAP_WIDTH / 2, MAP_HEIGHT / 2);
+	ResetVisibleTileCache();
+}
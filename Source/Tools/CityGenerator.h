@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// Seeded generator for synthetic cities. Everything is placed with the same checks the
+// interface uses (CanPlaceBuilding, PlaceBuilding, bridge rules for roads and power lines)
+// so the result is a city that could have been built by hand
+
+enum CityLayout
+{
+	Layout_Grid,			// Road grid with blocks of zones, services and power plants
+	Layout_PowerSnake,		// Power line snaking across the whole map before reaching any buildings
+	Layout_Traffic,			// Dense grid with most zones at high density so they have heavy traffic
+	Layout_Burning,			// Grid city with fires in progress
+	Num_Layouts
+};
+
+typedef struct
+{
+	uint32_t seed;
+	uint8_t layout;
+	uint8_t terrainType;
+	uint8_t maxBuildings;		// Stop placing buildings after this many
+	uint16_t ageMonths;			// Run the simulation for this long after building the city
+} CityGenParams;
+
+const char* GetLayoutName(uint8_t layout);
+int FindLayout(const char* name);
+
+void InitCityGenParams(CityGenParams* params);
+
+// Builds the city into City.state, replacing whatever was there before
+void GenerateCity(const CityGenParams* params);
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Game.h"
+#include "City.h"
+#include "Draw.h"
+#include "Interface.h"
+#include "BenchUtil.h"
+#include "CityFixtures.h"
+#include "NullPlatform.h"
+
+// Times drawing with the null platform layer, where PutPixel only counts pixels.
+// Whole frames are timed for a set of scripted scenarios and then each drawing step is timed on its own
+
+enum RenderScenario
+{
+	Scenario_Static,		// No scrolling, only animation
+	Scenario_ScrollPath,	// Cursor moves around the map so the tile cache scrolls every few frames
+	Scenario_Fire,			// Every visible building is on fire
+	Scenario_Powercut,		// Every visible building has lost power
+	Num_Scenarios
+};
+
+static const char* GetScenarioName(int scenario)
+{
+	switch (scenario)
+	{
+	case Scenario_Static: return "static";
+	case Scenario_ScrollPath: return "scrollpath";
+	case Scenario_Fire: return "fire";
+	case Scenario_Powercut: return "powercut";
+	default: return "unknown";
+	}
+}
+
+static bool IsBuildingVisible(Building* building)
+{
+	int screenX = building->x * TILE_SIZE - City.uiState.scrollX;
+	int screenY = building->y * TILE_SIZE - City.uiState.scrollY;
+	return screenX > -4 * TILE_SIZE && screenY > -4 * TILE_SIZE && screenX < DISPLAY_WIDTH && screenY < DISPLAY_HEIGHT;
+}
+
+// Walks the cursor around a rectangle that covers most of the map
+static void StepScrollPath(int frame)
+{
+	const int margin = 4;
+	const int width = MAP_WIDTH - margin * 2;
+	const int height = MAP_HEIGHT - margin * 2;
+	int position = frame % (2 * (width + height));
+
+	if (position < width)
+	{
+		City.uiState.selectX = margin + position;
+		City.uiState.selectY = margin;
+	}
+	else if (position < width + height)
+	{
+		City.uiState.selectX = margin + width;
+		City.uiState.selectY = margin + position - width;
+	}
+	else if (position < 2 * width + height)
+	{
+		City.uiState.selectX = margin + width - (position - width - height);
+		City.uiState.selectY = margin + height;
+	}
+	else
+	{
+		City.uiState.selectX = margin;
+		City.uiState.selectY = margin + height - (position - 2 * width - height);
+	}
+}
+
+static void SetupScenario(int scenario)
+{
+	BuildFixture(Fixture_Full);
+	FocusTile(MAP_WIDTH / 2, MAP_HEIGHT / 2);
+	ResetVisibleTileCache();
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		Building* building = &City.state.buildings[n];
+
+		if (!building->type || IsRubble(building->type) || !IsBuildingVisible(building))
+			continue;
+
+		if (scenario == Scenario_Fire && building->type != Park)
+		{
+			building->onFire = BUILDING_MAX_FIRE_COUNTER;
+			RefreshBuildingTiles(building);
+		}
+		else if (scenario == Scenario_Powercut)
+		{
+			building->hasPower = false;
+		}
+	}
+}
+
+static BenchResult TimeFrames(int scenario, int frames, double* pixelsPerFrame)
+{
+	std::vector<double> samples;
+	samples.reserve(frames);
+
+	SetupScenario(scenario);
+	ResetPixelCount();
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		if (scenario == Scenario_ScrollPath)
+		{
+			StepScrollPath(frame);
+			UpdateInterface();
+		}
+
+		BenchClock::time_point start = BenchClock::now();
+		Draw();
+		BenchClock::time_point end = BenchClock::now();
+
+		samples.push_back(ElapsedNs(start, end));
+	}
+
+	*pixelsPerFrame = frames > 0 ? (double)PixelCount / frames : 0;
+	return SummariseSamples(GetScenarioName(scenario), "Draw", samples);
+}
+
+template<typename Op>
+static BenchResult TimeStep(const char* name, int iterations, Op op)
+{
+	std::vector<double> samples;
+	samples.reserve(iterations);
+
+	for (int n = 0; n < iterations; n++)
+	{
+		BenchClock::time_point start = BenchClock::now();
+		op(n);
+		BenchClock::time_point end = BenchClock::now();
+
+		samples.push_back(ElapsedNs(start, end));
+	}
+
+	return SummariseSamples("phase", name, samples);
+}
+
+static void PrintUsage()
+{
+	printf("Usage: microcity_renderbench [options]\n");
+	printf("  --frames N       Frames per scenario (default 2000)\n");
+	printf("  --json FILE      Also write the results as JSON\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = 2000;
+	const char* jsonFileName = nullptr;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--frames") && hasValue)
+		{
+			frames = atoi(argv[++n]);
+		}
+		else if (!strcmp(argv[n], "--json") && hasValue)
+		{
+			jsonFileName = argv[++n];
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+
+	for (int scenario = 0; scenario < Num_Scenarios; scenario++)
+	{
+		double pixelsPerFrame;
+		results.push_back(TimeFrames(scenario, frames, &pixelsPerFrame));
+		printf("Scenario '%s': %.0f PutPixel calls per frame\n", GetScenarioName(scenario), pixelsPerFrame);
+	}
+
+	// Each drawing step on its own, from the middle of the full city
+	SetupScenario(Scenario_Powercut);
+
+	results.push_back(TimeStep("DrawTiles", frames, [](int) { DrawTiles(); }));
+	results.push_back(TimeStep("ResetVisibleTileCache", frames, [](int) { ResetVisibleTileCache(); }));
+	results.push_back(TimeStep("AnimatePowercuts", frames, [](int) { AnimatePowercuts(); }));
+
+	// Scroll back and forth so the view stays in the middle of the map, each sample is a pair of scrolls
+	results.push_back(TimeStep("ScrollLeft+ScrollRight", frames, [](int) { ScrollLeft(1); ScrollRight(1); }));
+	results.push_back(TimeStep("ScrollUp+ScrollDown", frames, [](int) { ScrollUp(1); ScrollDown(1); }));
+
+	PrintResultTable(results, "ns/frame");
+
+	if (jsonFileName && !WriteResultJson(jsonFileName, "render", "ns/frame", results))
+	{
+		fprintf(stderr, "Could not write %s\n", jsonFileName);
+		return 1;
+	}
+
+	return 0;
+}
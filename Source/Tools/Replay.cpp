@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "City.h"
+#include "Simulation.h"
+#include "Replay.h"
+
+#define REPLAY_VERSION 1
+
+static const char ReplayMagic[4] = { 'M', 'C', 'R', 'P' };
+
+void BeginRecording(ReplayRecording* recording)
+{
+	recording->startState = City.state;
+	recording->startUIState = City.uiState;
+	recording->startRandState = GetRandState();
+	recording->inputs.clear();
+
+	// Key repeat state isn't saved so start from no keys held
+	ResetInputState();
+}
+
+void RecordInput(ReplayRecording* recording, uint8_t input)
+{
+	recording->inputs.push_back(input);
+}
+
+static void WriteU32(FILE* fs, uint32_t val)
+{
+	uint8_t bytes[4] = { (uint8_t)val, (uint8_t)(val >> 8), (uint8_t)(val >> 16), (uint8_t)(val >> 24) };
+	fwrite(bytes, 1, 4, fs);
+}
+
+static bool ReadU32(FILE* fs, uint32_t* val)
+{
+	uint8_t bytes[4];
+	if (fread(bytes, 1, 4, fs) != 4)
+		return false;
+	*val = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	return true;
+}
+
+// Run lengths are stored 7 bits at a time with the top bit set if more bytes follow
+static void WriteRunLength(FILE* fs, uint32_t val)
+{
+	while (val >= 0x80)
+	{
+		fputc((val & 0x7f) | 0x80, fs);
+		val >>= 7;
+	}
+	fputc(val, fs);
+}
+
+static bool ReadRunLength(FILE* fs, uint32_t* val)
+{
+	*val = 0;
+	for (int shift = 0; shift < 32; shift += 7)
+	{
+		int byte = fgetc(fs);
+		if (byte == EOF)
+			return false;
+		*val |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+bool SaveRecording(const ReplayRecording* recording, const char* fileName)
+{
+	FILE* fs = fopen(fileName, "wb");
+
+	if (!fs)
+		return false;
+
+	fwrite(ReplayMagic, 1, sizeof(ReplayMagic), fs);
+	fputc(REPLAY_VERSION, fs);
+	fputc(recording->startRandState & 0xff, fs);
+	fputc(recording->startRandState >> 8, fs);
+	WriteU32(fs, sizeof(GameState));
+	fwrite(&recording->startState, sizeof(GameState), 1, fs);
+	WriteU32(fs, sizeof(UIStateStruct));
+	fwrite(&recording->startUIState, sizeof(UIStateStruct), 1, fs);
+	WriteU32(fs, (uint32_t)recording->inputs.size());
+
+	size_t n = 0;
+	while (n < recording->inputs.size())
+	{
+		uint8_t input = recording->inputs[n];
+		uint32_t runLength = 1;
+		while (n + runLength < recording->inputs.size() && recording->inputs[n + runLength] == input)
+		{
+			runLength++;
+		}
+
+		fputc(input, fs);
+		WriteRunLength(fs, runLength);
+		n += runLength;
+	}
+
+	bool success = ferror(fs) == 0;
+	fclose(fs);
+	return success;
+}
+
+static bool IsValidStateSize(uint32_t stateSize)
+{
+#ifdef USE_COUNTER_RNG
+	if (stateSize == LEGACY_GAME_STATE_SIZE)
+		return true;
+#endif
+	return stateSize == sizeof(GameState);
+}
+
+bool LoadRecording(ReplayRecording* recording, const char* fileName)
+{
+	FILE* fs = fopen(fileName, "rb");
+
+	if (!fs)
+		return false;
+
+	char magic[4];
+	uint32_t stateSize = 0, uiStateSize = 0, numFrames = 0;
+	bool valid = fread(magic, 1, sizeof(magic), fs) == sizeof(magic)
+		&& !memcmp(magic, ReplayMagic, sizeof(magic))
+		&& fgetc(fs) == REPLAY_VERSION;
+
+	if (valid)
+	{
+		int randLow = fgetc(fs);
+		int randHigh = fgetc(fs);
+		recording->startRandState = (uint16_t)(randLow | (randHigh << 8));
+
+		// The state is stored as raw structs so the file is only valid for builds with the same layout.
+		// Recordings from before the random seed was added are missing it and use the LFSR throughout
+		memset(&recording->startState, 0, sizeof(GameState));
+		valid = randHigh != EOF
+			&& ReadU32(fs, &stateSize) && IsValidStateSize(stateSize)
+			&& fread(&recording->startState, stateSize, 1, fs) == 1
+			&& ReadU32(fs, &uiStateSize) && uiStateSize == sizeof(UIStateStruct)
+			&& fread(&recording->startUIState, sizeof(UIStateStruct), 1, fs) == 1
+			&& ReadU32(fs, &numFrames);
+	}
+
+	recording->inputs.clear();
+
+	while (valid && recording->inputs.size() < numFrames)
+	{
+		int input = fgetc(fs);
+		uint32_t runLength;
+
+		if (input == EOF || !ReadRunLength(fs, &runLength) || runLength > numFrames - recording->inputs.size())
+		{
+			valid = false;
+			break;
+		}
+
+		recording->inputs.insert(recording->inputs.end(), runLength, (uint8_t)input);
+	}
+
+	fclose(fs);
+
+	if (!valid)
+		return false;
+
+	City.state = recording->startState;
+	City.uiState = recording->startUIState;
+	SetRandState(recording->startRandState);
+#ifdef USE_COUNTER_RNG
+	SetLegacyRandom(stateSize != sizeof(GameState));
+#endif
+	ResetInputState();
+	ResetSimulationCaches();
+	return true;
+}
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static void HashBytes(uint64_t* hash, const void* data, size_t length)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t n = 0; n < length; n++)
+	{
+		*hash ^= bytes[n];
+		*hash *= FNV_PRIME;
+	}
+}
+
+template<typename T>
+static void HashValue(uint64_t* hash, T value)
+{
+	HashBytes(hash, &value, sizeof(T));
+}
+
+uint64_t HashGameState()
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+
+	HashValue(&hash, City.state.year);
+	HashValue(&hash, City.state.month);
+	HashValue(&hash, City.state.simulationStep);
+	HashValue(&hash, City.state.money);
+	HashBytes(&hash, City.state.connectionMap, sizeof(City.state.connectionMap));
+	HashValue(&hash, City.state.terrainType);
+	HashValue(&hash, City.state.taxRate);
+	HashValue(&hash, City.state.residentialPopulation);
+	HashValue(&hash, City.state.industrialPopulation);
+	HashValue(&hash, City.state.commercialPopulation);
+	HashValue(&hash, City.state.taxesCollected);
+	HashValue(&hash, City.state.policeBudget);
+	HashValue(&hash, City.state.fireBudget);
+	HashValue(&hash, City.state.roadBudget);
+	HashValue(&hash, City.state.timeToNextDisaster);
+
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		const Building& building = City.state.buildings[n];
+		uint8_t packed[5] =
+		{
+			(uint8_t)building.x,
+			(uint8_t)building.y,
+			(uint8_t)building.type,
+			(uint8_t)building.populationDensity,
+			(uint8_t)(building.onFire | (building.heavyTraffic << 2) | (building.hasPower << 3))
+		};
+		HashBytes(&hash, packed, sizeof(packed));
+	}
+
+	HashValue(&hash, GetRandState());
+#ifdef USE_COUNTER_RNG
+	// Left out for cities without a seed so hashes from older builds still match
+	if (City.state.randomSeed)
+		HashValue(&hash, City.state.randomSeed);
+#endif
+	return hash;
+}
+
+uint64_t HashUIState()
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+
+	HashValue(&hash, City.uiState.scrollX);
+	HashValue(&hash, City.uiState.scrollY);
+	HashValue(&hash, City.uiState.selectX);
+	HashValue(&hash, City.uiState.selectY);
+	HashValue(&hash, City.uiState.brush);
+	HashValue(&hash, City.uiState.selection);
+	HashValue(&hash, City.uiState.state);
+	HashValue(&hash, (uint8_t)City.uiState.autoBudget);
+	return hash;
+}
+
+bool WriteFrameHashes(const std::vector<FrameHash>& hashes, const char* fileName)
+{
+	FILE* fs = fopen(fileName, "w");
+
+	if (!fs)
+		return false;
+
+	for (const FrameHash& hash : hashes)
+	{
+		fprintf(fs, "%" PRIu32 " %016" PRIx64 " %016" PRIx64 "\n", hash.frame, hash.gameHash, hash.uiHash);
+	}
+
+	bool success = ferror(fs) == 0;
+	fclose(fs);
+	return success;
+}
+
+bool ReadFrameHashes(std::vector<FrameHash>& hashes, const char* fileName)
+{
+	FILE* fs = fopen(fileName, "r");
+
+	if (!fs)
+		return false;
+
+	hashes.clear();
+
+	FrameHash hash;
+	while (fscanf(fs, "%" SCNu32 " %" SCNx64 " %" SCNx64, &hash.frame, &hash.gameHash, &hash.uiHash) == 3)
+	{
+		hashes.push_back(hash);
+	}
+
+	fclose(fs);
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "Game.h"
+#include "Interface.h"
+
+// Input replays: the starting GameState, UI state and random number generator state followed by
+// the GetInput() mask for every frame. Inputs are stored as run lengths since masks are usually held
+// for many frames. Playing the inputs back through TickGame reproduces the recorded session exactly
+
+struct ReplayRecording
+{
+	GameState startState;
+	UIStateStruct startUIState;
+	uint16_t startRandState;
+	std::vector<uint8_t> inputs;	// One mask per frame
+};
+
+// Snapshot the current state as the start of a recording
+void BeginRecording(ReplayRecording* recording);
+void RecordInput(ReplayRecording* recording, uint8_t input);
+bool SaveRecording(const ReplayRecording* recording, const char* fileName);
+
+// Loads a recording and restores the state it started from
+bool LoadRecording(ReplayRecording* recording, const char* fileName);
+
+// 64 bit FNV-1a hashes of each field, so padding bytes don't affect the result
+uint64_t HashGameState(void);
+uint64_t HashUIState(void);
+
+// Per frame hashes written by the replay tool, one "frame gamehash uihash" line per frame
+struct FrameHash
+{
+	uint32_t frame;
+	uint64_t gameHash;
+	uint64_t uiHash;
+};
+
+bool WriteFrameHashes(const std::vector<FrameHash>& hashes, const char* fileName);
+bool ReadFrameHashes(std::vector<FrameHash>& hashes, const char* fileName);
@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <chrono>
+#include "Game.h"
+#include "City.h"
+#include "CitySnapshot.h"
+#include "Draw.h"
+#include "Interface.h"
+#include "InfluenceKernel.h"
+#include "Simulation.h"
+#include "NullPlatform.h"
+#include "Replay.h"
+
+// Records scripted input sessions and replays them headlessly, writing a hash of the game state
+// after every frame. Comparing the hashes from two builds shows the first frame where they disagree
+
+#define REPLAY_SAVEGAME_NAME "replaycity.cty"
+
+static void PrintUsage()
+{
+	printf("Usage:\n");
+	printf("  microcity_replay record OUT [--frames N] [--seed S] [--load FILE] [--terrain N] [--hashes FILE]\n");
+	printf("      Record N frames of pseudo random input (default 20000) starting from a new or saved city\n");
+	printf("  microcity_replay play REPLAY [--hashes FILE] [--check FILE] [--kernel scalar|sse2|avx2]\n");
+	printf("      Replay a recording, writing per frame hashes and/or checking them against a previous run\n");
+	printf("  microcity_replay diff HASHES_A HASHES_B\n");
+	printf("      Report the first frame where two hash files diverge\n");
+#ifdef USE_CITY_SNAPSHOTS
+	printf("  microcity_replay snapshots REPLAY [--interval N] [--span N] [--zone-schedule exact|settled]\n");
+	printf("      Replay a recording taking a snapshot every N frames (default 500), check forks and diffs against\n");
+	printf("      the hashes, then restore them latest first and play on for a span (default 200) alongside a city\n");
+	printf("      restored with every cache rebuilt, checking both against the recording\n");
+#endif
+}
+
+// Pseudo random button presses that move the cursor around, open the toolbar and place things
+static uint32_t MonkeyState = 1;
+static uint8_t MonkeyInput = 0;
+static int MonkeyHoldFrames = 0;
+
+static uint32_t MonkeyRand()
+{
+	MonkeyState ^= MonkeyState << 13;
+	MonkeyState ^= MonkeyState >> 17;
+	MonkeyState ^= MonkeyState << 5;
+	return MonkeyState;
+}
+
+static uint8_t NextMonkeyInput()
+{
+	if (MonkeyHoldFrames > 0)
+	{
+		MonkeyHoldFrames--;
+		return MonkeyInput;
+	}
+
+	uint32_t choice = MonkeyRand() % 16;
+
+	if (choice < 8)
+	{
+		static const uint8_t Directions[] = { INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN };
+		MonkeyInput = Directions[choice & 3];
+		MonkeyHoldFrames = MonkeyRand() % 16;
+	}
+	else if (choice < 11)
+	{
+		MonkeyInput = INPUT_B;
+		MonkeyHoldFrames = 0;
+	}
+	else if (choice < 12)
+	{
+		MonkeyInput = INPUT_A;
+		MonkeyHoldFrames = 0;
+	}
+	else
+	{
+		MonkeyInput = 0;
+		MonkeyHoldFrames = MonkeyRand() % 32;
+	}
+
+	return MonkeyInput;
+}
+
+static FrameHash GetFrameHash(uint32_t frame)
+{
+	FrameHash hash;
+	hash.frame = frame;
+	hash.gameHash = HashGameState();
+	hash.uiHash = HashUIState();
+	return hash;
+}
+
+// Returns the index of the first differing entry or -1 if they match
+static int FindDivergence(const std::vector<FrameHash>& a, const std::vector<FrameHash>& b, bool* gameStateDiffers)
+{
+	size_t count = a.size() < b.size() ? a.size() : b.size();
+
+	for (size_t n = 0; n < count; n++)
+	{
+		if (a[n].frame != b[n].frame || a[n].gameHash != b[n].gameHash || a[n].uiHash != b[n].uiHash)
+		{
+			*gameStateDiffers = a[n].gameHash != b[n].gameHash;
+			return (int)n;
+		}
+	}
+
+	if (a.size() != b.size())
+	{
+		*gameStateDiffers = false;
+		return (int)count;
+	}
+
+	return -1;
+}
+
+static int ReportDivergence(const std::vector<FrameHash>& a, const std::vector<FrameHash>& b)
+{
+	bool gameStateDiffers = false;
+	int index = FindDivergence(a, b, &gameStateDiffers);
+
+	if (index < 0)
+	{
+		printf("Identical: %zu frames\n", a.size());
+		return 0;
+	}
+
+	if ((size_t)index >= a.size() || (size_t)index >= b.size())
+	{
+		printf("Diverged: runs have different lengths (%zu and %zu frames)\n", a.size(), b.size());
+	}
+	else
+	{
+		printf("Diverged at frame %" PRIu32 ": %s differs\n", a[index].frame, gameStateDiffers ? "GameState" : "City.uiState");
+	}
+	return 1;
+}
+
+static int Record(int argc, char* argv[])
+{
+	const char* outFileName = argv[0];
+	const char* loadFileName = nullptr;
+	const char* hashFileName = nullptr;
+	uint32_t numFrames = 20000;
+	uint8_t terrainType = 0;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--frames") && hasValue)
+			numFrames = (uint32_t)strtoul(argv[++n], nullptr, 10);
+		else if (!strcmp(argv[n], "--seed") && hasValue)
+			MonkeyState = (uint32_t)strtoul(argv[++n], nullptr, 10) | 1;
+		else if (!strcmp(argv[n], "--load") && hasValue)
+			loadFileName = argv[++n];
+		else if (!strcmp(argv[n], "--terrain") && hasValue)
+			terrainType = (uint8_t)(atoi(argv[++n]) % NUM_TERRAIN_TYPES);
+		else if (!strcmp(argv[n], "--hashes") && hasValue)
+			hashFileName = argv[++n];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	InitGame();
+	SetTerrainType(terrainType);
+
+	if (loadFileName)
+	{
+		SetSaveFileName(loadFileName);
+		if (!LoadCity())
+		{
+			fprintf(stderr, "Could not load city from %s\n", loadFileName);
+			return 1;
+		}
+	}
+
+	City.uiState.state = InGame;
+	ResetSimulationCaches();
+	ResetVisibleTileCache();
+
+	// Saving and loading from the menus during the session uses a scratch file that starts out missing
+	SetSaveFileName(REPLAY_SAVEGAME_NAME);
+	remove(REPLAY_SAVEGAME_NAME);
+
+	ReplayRecording recording;
+	std::vector<FrameHash> hashes;
+	BeginRecording(&recording);
+
+	for (uint32_t frame = 0; frame < numFrames; frame++)
+	{
+		uint8_t input = NextMonkeyInput();
+		RecordInput(&recording, input);
+		SetInputMask(input);
+		TickGame();
+		hashes.push_back(GetFrameHash(frame));
+	}
+
+	remove(REPLAY_SAVEGAME_NAME);
+
+	if (!SaveRecording(&recording, outFileName))
+	{
+		fprintf(stderr, "Could not write %s\n", outFileName);
+		return 1;
+	}
+
+	if (hashFileName && !WriteFrameHashes(hashes, hashFileName))
+	{
+		fprintf(stderr, "Could not write %s\n", hashFileName);
+		return 1;
+	}
+
+	printf("Recorded %u frames to %s\n", numFrames, outFileName);
+	return 0;
+}
+
+static int Play(int argc, char* argv[])
+{
+	const char* replayFileName = argv[0];
+	const char* hashFileName = nullptr;
+	const char* checkFileName = nullptr;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--hashes") && hasValue)
+			hashFileName = argv[++n];
+		else if (!strcmp(argv[n], "--check") && hasValue)
+			checkFileName = argv[++n];
+#ifdef USE_BUILDING_INDEX
+		else if (!strcmp(argv[n], "--kernel") && hasValue)
+		{
+			const char* kernelName = argv[++n];
+			if (!SetInfluenceKernel(FindInfluenceKernel(kernelName)))
+			{
+				fprintf(stderr, "Influence kernel '%s' is not available\n", kernelName);
+				return 1;
+			}
+		}
+#endif
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	ReplayRecording recording;
+
+	if (!LoadRecording(&recording, replayFileName))
+	{
+		fprintf(stderr, "Could not load replay %s\n", replayFileName);
+		return 1;
+	}
+
+	ResetVisibleTileCache();
+	SetSaveFileName(REPLAY_SAVEGAME_NAME);
+	remove(REPLAY_SAVEGAME_NAME);
+
+	std::vector<FrameHash> hashes;
+	hashes.reserve(recording.inputs.size());
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	for (size_t frame = 0; frame < recording.inputs.size(); frame++)
+	{
+		SetInputMask(recording.inputs[frame]);
+		TickGame();
+		hashes.push_back(GetFrameHash((uint32_t)frame));
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(endTime - startTime).count();
+
+	remove(REPLAY_SAVEGAME_NAME);
+
+	int numBuildings = 0;
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.state.buildings[n].type)
+			numBuildings++;
+	}
+
+	printf("Replayed %zu frames in %.3f s: %.0f frames/sec\n", hashes.size(), seconds, seconds > 0 ? hashes.size() / seconds : 0.0);
+	printf("Ended in %d with %d buildings, funds: $%d\n", City.state.year + 1900, numBuildings, (int)City.state.money);
+
+	if (hashFileName && !WriteFrameHashes(hashes, hashFileName))
+	{
+		fprintf(stderr, "Could not write %s\n", hashFileName);
+		return 1;
+	}
+
+	if (checkFileName)
+	{
+		std::vector<FrameHash> reference;
+		if (!ReadFrameHashes(reference, checkFileName))
+		{
+			fprintf(stderr, "Could not read %s\n", checkFileName);
+			return 1;
+		}
+
+		return ReportDivergence(reference, hashes);
+	}
+
+	return 0;
+}
+
+static int Diff(int argc, char* argv[])
+{
+	if (argc != 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::vector<FrameHash> a, b;
+
+	if (!ReadFrameHashes(a, argv[0]) || !ReadFrameHashes(b, argv[1]))
+	{
+		fprintf(stderr, "Could not read hash files\n");
+		return 1;
+	}
+
+	return ReportDivergence(a, b);
+}
+
+#ifdef USE_CITY_SNAPSHOTS
+struct ReplaySnapshot
+{
+	size_t frame;				// Taken after this frame
+	CitySnapshot* snapshot;
+	uint64_t gameHash;
+
+	// The interface isn't part of a snapshot
+	UIStateStruct uiState;
+	uint8_t lastInput;
+	uint8_t inputRepeatCounter;
+
+	// Nor is the file the recording saves to and loads from
+	bool hasSaveFile;
+	GameState saveFile;
+};
+
+static void KeepSaveFile(ReplaySnapshot& snapshot)
+{
+	FILE* fs = fopen(REPLAY_SAVEGAME_NAME, "rb");
+
+	snapshot.hasSaveFile = fs != nullptr;
+	memset(&snapshot.saveFile, 0, sizeof(GameState));
+	if (fs)
+	{
+		snapshot.hasSaveFile = fread(&snapshot.saveFile, sizeof(GameState), 1, fs) == 1;
+		fclose(fs);
+	}
+}
+
+static void RestoreSaveFile(const ReplaySnapshot& snapshot)
+{
+	remove(REPLAY_SAVEGAME_NAME);
+
+	if (snapshot.hasSaveFile)
+	{
+		FILE* fs = fopen(REPLAY_SAVEGAME_NAME, "wb");
+		if (fs)
+		{
+			fwrite(&snapshot.saveFile, sizeof(GameState), 1, fs);
+			fclose(fs);
+		}
+	}
+}
+
+static void RestoreInterface(CityContext* city, const ReplaySnapshot& snapshot)
+{
+	city->uiState = snapshot.uiState;
+	city->lastInput = snapshot.lastInput;
+	city->inputRepeatCounter = snapshot.inputRepeatCounter;
+}
+
+static FrameHash GetCityFrameHash(CityContext* city, uint32_t frame)
+{
+	CurrentCityScope scope(city);
+	return GetFrameHash(frame);
+}
+
+static bool IsVisibleTileCacheFresh()
+{
+	uint8_t cached[sizeof(City.visibleTileCache)];
+	memcpy(cached, City.visibleTileCache, sizeof(cached));
+	ResetVisibleTileCache();
+	return !memcmp(cached, City.visibleTileCache, sizeof(cached));
+}
+
+static int Snapshots(int argc, char* argv[])
+{
+	const char* replayFileName = argv[0];
+	size_t interval = 500;
+	size_t span = 200;
+	uint8_t zoneSchedule = ZoneSchedule_Exact;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--interval") && hasValue)
+			interval = (size_t)strtoul(argv[++n], nullptr, 10);
+		else if (!strcmp(argv[n], "--span") && hasValue)
+			span = (size_t)strtoul(argv[++n], nullptr, 10);
+#ifdef USE_ZONE_SCHEDULER
+		else if (!strcmp(argv[n], "--zone-schedule") && hasValue)
+		{
+			n++;
+			if (!strcmp(argv[n], "exact"))
+				zoneSchedule = ZoneSchedule_Exact;
+			else if (!strcmp(argv[n], "settled"))
+				zoneSchedule = ZoneSchedule_Settled;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+#endif
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	ReplayRecording recording;
+
+	if (!LoadRecording(&recording, replayFileName) || interval == 0)
+	{
+		fprintf(stderr, "Could not load replay %s\n", replayFileName);
+		return 1;
+	}
+
+	ResetVisibleTileCache();
+	SetSaveFileName(REPLAY_SAVEGAME_NAME);
+	remove(REPLAY_SAVEGAME_NAME);
+
+	CityContext* city = GetMainCity();
+#ifdef USE_ZONE_SCHEDULER
+	SetZoneSchedule(zoneSchedule);
+#endif
+	std::vector<ReplaySnapshot> snapshots;
+	std::vector<uint64_t> gameHashes;
+	int failures = 0;
+
+	// Each snapshot shares what it can with the one before
+	for (size_t frame = 0; frame < recording.inputs.size(); frame++)
+	{
+		SetInputMask(recording.inputs[frame]);
+		TickGame();
+		gameHashes.push_back(HashGameState());
+
+		if ((frame + 1) % interval == 0)
+		{
+			ReplaySnapshot snapshot;
+			snapshot.frame = frame;
+			snapshot.snapshot = TakeCitySnapshot(city, snapshots.empty() ? nullptr : snapshots.back().snapshot);
+			snapshot.gameHash = gameHashes.back();
+			snapshot.uiState = City.uiState;
+			snapshot.lastInput = City.lastInput;
+			snapshot.inputRepeatCounter = City.inputRepeatCounter;
+			KeepSaveFile(snapshot);
+			snapshots.push_back(snapshot);
+		}
+	}
+
+	size_t numChangedBlocks = 0;
+
+	for (size_t n = 0; n < snapshots.size(); n++)
+	{
+		CitySnapshotDiff diff;
+		CitySnapshot* fork = ForkCitySnapshot(snapshots[n].snapshot);
+		DiffCitySnapshots(fork, snapshots[n].snapshot, &diff);
+		DiscardCitySnapshot(fork);
+
+		if (diff.numChangedBlocks || diff.numChangedProgressBlocks || diff.otherStateChanged)
+		{
+			printf("Fork of the snapshot after frame %zu differs from it\n", snapshots[n].frame);
+			failures++;
+		}
+
+		if (n == 0)
+			continue;
+
+		DiffCitySnapshots(snapshots[n - 1].snapshot, snapshots[n].snapshot, &diff);
+		numChangedBlocks += diff.numChangedBlocks + diff.numChangedProgressBlocks;
+		bool changed = diff.numChangedBlocks || diff.otherStateChanged;
+
+		if (changed != (snapshots[n - 1].gameHash != snapshots[n].gameHash))
+		{
+			printf("Diff of the snapshots after frames %zu and %zu doesn't agree with their hashes\n", snapshots[n - 1].frame, snapshots[n].frame);
+			failures++;
+		}
+	}
+
+	double restoreSeconds = 0;
+	double rebuildSeconds = 0;
+
+	// Latest first so every restore starts from a city which has moved on somewhere else
+	for (size_t n = snapshots.size(); n-- > 0;)
+	{
+		const ReplaySnapshot& snapshot = snapshots[n];
+
+		// Playing leaves some tiles for the next draw to catch up on, so only what the restore leaves is checked
+		ResetVisibleTileCache();
+
+		auto restoreStart = std::chrono::steady_clock::now();
+		RestoreCitySnapshot(city, snapshot.snapshot);
+		restoreSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - restoreStart).count();
+
+		if (HashGameState() != snapshot.gameHash)
+		{
+			printf("Restoring the snapshot after frame %zu gave a different GameState\n", snapshot.frame);
+			failures++;
+		}
+		if (!IsVisibleTileCacheFresh())
+		{
+			printf("Restoring the snapshot after frame %zu left stale tiles\n", snapshot.frame);
+			failures++;
+		}
+		RestoreInterface(city, snapshot);
+		ResetVisibleTileCache();
+
+		// The same snapshot in a new city, with every cache worked out from scratch. Restoring it again
+		// only puts back the work in progress the reset threw away
+		CityContext* reference = CreateCity(0);
+#ifdef USE_ZONE_SCHEDULER
+		{
+			CurrentCityScope scope(reference);
+			SetZoneSchedule(zoneSchedule);
+		}
+#endif
+		RestoreCitySnapshot(reference, snapshot.snapshot);
+		RestoreInterface(reference, snapshot);
+		{
+			CurrentCityScope scope(reference);
+			auto rebuildStart = std::chrono::steady_clock::now();
+			ResetSimulationCaches();
+			ResetVisibleTileCache();
+			rebuildSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - rebuildStart).count();
+		}
+		RestoreCitySnapshot(reference, snapshot.snapshot);
+		RestoreSaveFile(snapshot);
+
+		for (size_t frame = snapshot.frame + 1; frame <= snapshot.frame + span && frame < recording.inputs.size(); frame++)
+		{
+			SetInputMask(recording.inputs[frame]);
+			TickGame(city);
+			SetInputMask(recording.inputs[frame]);
+			TickGame(reference);
+
+			FrameHash restored = GetCityFrameHash(city, (uint32_t)frame);
+			FrameHash rebuilt = GetCityFrameHash(reference, (uint32_t)frame);
+
+			if (restored.gameHash != rebuilt.gameHash || restored.uiHash != rebuilt.uiHash)
+			{
+				printf("Playing on from the snapshot after frame %zu diverged from a rebuilt city at frame %zu\n", snapshot.frame, frame);
+				failures++;
+				break;
+			}
+			if (restored.gameHash != gameHashes[frame])
+			{
+				printf("Playing on from the snapshot after frame %zu diverged from the recording at frame %zu\n", snapshot.frame, frame);
+				failures++;
+				break;
+			}
+		}
+
+		DestroyCity(reference);
+	}
+
+	remove(REPLAY_SAVEGAME_NAME);
+
+	size_t blocksPerSnapshot = CITY_SNAPSHOT_NUM_BLOCKS + GetCitySnapshotProgressBlocks();
+	size_t numBlocks = snapshots.size() * blocksPerSnapshot;
+	size_t storedBlocks = snapshots.empty() ? 0 : blocksPerSnapshot + numChangedBlocks;
+
+	printf("Took %zu snapshots: %zu blocks stored for %zu (%.1f%%)\n", snapshots.size(), storedBlocks, numBlocks,
+		numBlocks ? storedBlocks * 100.0 / numBlocks : 0.0);
+	if (!snapshots.empty())
+	{
+		printf("Restore: %.1f us, rebuilding every cache instead: %.1f us\n",
+			restoreSeconds * 1e6 / snapshots.size(), rebuildSeconds * 1e6 / snapshots.size());
+	}
+
+	for (size_t n = 0; n < snapshots.size(); n++)
+	{
+		DiscardCitySnapshot(snapshots[n].snapshot);
+	}
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All checks passed\n");
+	return 0;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 3 && !strcmp(argv[1], "record"))
+		return Record(argc - 2, argv + 2);
+	if (argc >= 3 && !strcmp(argv[1], "play"))
+		return Play(argc - 2, argv + 2);
+	if (argc >= 2 && !strcmp(argv[1], "diff"))
+		return Diff(argc - 2, argv + 2);
+#ifdef USE_CITY_SNAPSHOTS
+	if (argc >= 3 && !strcmp(argv[1], "snapshots"))
+		return Snapshots(argc - 2, argv + 2);
+#endif
+
+	PrintUsage();
+	return 1;
+}
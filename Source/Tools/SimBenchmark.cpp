@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Game.h"
+#include "City.h"
+#include "Interface.h"
+#include "InfluenceKernel.h"
+#include "Simulation.h"
+#include "BenchUtil.h"
+#include "CityFixtures.h"
+#include "Draw.h"
+#include "NullPlatform.h"
+
+// Times each of the simulation steps on its own against a set of fixed cities.
+// City.state is restored from a snapshot before every sample so each sample does the same work
+
+static const char* const BuildingTypeNames[] =
+{
+	"None", "Residential", "Commercial", "Industrial", "Powerplant",
+	"Park", "PoliceDept", "FireDept", "Stadium", "Rubble3x3", "Rubble4x4"
+};
+
+static GameState SnapshotState;
+static UIStateStruct SnapshotUIState;
+
+static void TakeSnapshot()
+{
+	SnapshotState = City.state;
+	SnapshotUIState = City.uiState;
+}
+
+static void RestoreSnapshot()
+{
+	City.state = SnapshotState;
+	City.uiState = SnapshotUIState;
+	ResetSimulationCaches();
+}
+
+// Calls 'op' with the next sample index 'iterations' times and records how long each call took
+template<typename Setup, typename Op>
+static BenchResult TimePhase(const char* fixtureName, const std::string& phaseName, int iterations, Setup setup, Op op)
+{
+	std::vector<double> samples;
+	samples.reserve(iterations);
+
+	for (int n = 0; n < iterations; n++)
+	{
+		RestoreSnapshot();
+		setup(n);
+
+		BenchClock::time_point start = BenchClock::now();
+		op(n);
+		BenchClock::time_point end = BenchClock::now();
+
+		samples.push_back(ElapsedNs(start, end));
+	}
+
+	RestoreSnapshot();
+	return SummariseSamples(fixtureName, phaseName, samples);
+}
+
+static void NoSetup(int)
+{
+}
+
+// Benchmarks whichever city is currently in City.state
+static void BenchmarkCity(const char* fixtureName, int iterations, std::vector<BenchResult>& results)
+{
+	TakeSnapshot();
+
+	int numBuildings = 0;
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (City.state.buildings[n].type)
+			numBuildings++;
+	}
+	printf("Fixture '%s': %d buildings\n", fixtureName, numBuildings);
+
+	// SimulateBuilding, grouped by building type
+	for (uint8_t type = Residential; type < Num_BuildingTypes; type++)
+	{
+		std::vector<int> indices;
+		for (int n = 0; n < MAX_BUILDINGS; n++)
+		{
+			if (City.state.buildings[n].type == type)
+				indices.push_back(n);
+		}
+
+		if (indices.empty())
+			continue;
+
+		results.push_back(TimePhase(fixtureName, std::string("SimulateBuilding:") + BuildingTypeNames[type], iterations, NoSetup,
+			[&](int n) { SimulateBuilding(&City.state.buildings[indices[n % indices.size()]]); }));
+	}
+
+	// Burning buildings are ticked by SimulateFire and are needed for SpreadFire
+	std::vector<int> flammable;
+	for (int n = 0; n < MAX_BUILDINGS; n++)
+	{
+		if (CanCatchFire(&City.state.buildings[n]))
+			flammable.push_back(n);
+	}
+
+	if (!flammable.empty())
+	{
+		auto igniteBuilding = [&](int n)
+		{
+			Building* building = &City.state.buildings[flammable[n % flammable.size()]];
+			building->onFire = 1;
+			UpdateBuildingCaches(building);
+		};
+
+		results.push_back(TimePhase(fixtureName, "SimulateFire", iterations, igniteBuilding,
+			[&](int n) { SimulateFire(&City.state.buildings[flammable[n % flammable.size()]], 0); }));
+		results.push_back(TimePhase(fixtureName, "SpreadFire", iterations, igniteBuilding,
+			[&](int n) { SpreadFire(&City.state.buildings[flammable[n % flammable.size()]], 0); }));
+	}
+
+	results.push_back(TimePhase(fixtureName, "StartRandomFire", iterations, NoSetup, [](int) { StartRandomFire(); }));
+	results.push_back(TimePhase(fixtureName, "CalculatePowerConnectivity", iterations, NoSetup, [](int) { CalculatePowerConnectivity(); }));
+	results.push_back(TimePhase(fixtureName, "CountPopulation", iterations, NoSetup, [](int) { CountPopulation(); }));
+	results.push_back(TimePhase(fixtureName, "DoBudget", iterations, NoSetup, [](int) { DoBudget(); }));
+}
+
+static void PrintUsage()
+{
+	printf("Usage: microcity_simbench [options]\n");
+	printf("  --iterations N   Samples per phase (default 2000)\n");
+	printf("  --fixture NAME   Only run one fixture (empty, sparse, full, powermaze)\n");
+	printf("  --load FILE      Also benchmark a saved city, can be repeated\n");
+	printf("  --json FILE      Also write the results as JSON\n");
+	printf("  --kernel NAME    Influence kernel to use (scalar, sse2, avx2), the default is the fastest supported\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 2000;
+	const char* jsonFileName = nullptr;
+	int onlyFixture = -1;
+	std::vector<const char*> loadFileNames;
+
+	for (int n = 1; n < argc; n++)
+	{
+		bool hasValue = n + 1 < argc;
+
+		if (!strcmp(argv[n], "--iterations") && hasValue)
+		{
+			iterations = atoi(argv[++n]);
+		}
+		else if (!strcmp(argv[n], "--load") && hasValue)
+		{
+			loadFileNames.push_back(argv[++n]);
+		}
+		else if (!strcmp(argv[n], "--json") && hasValue)
+		{
+			jsonFileName = argv[++n];
+		}
+#ifdef USE_BUILDING_INDEX
+		else if (!strcmp(argv[n], "--kernel") && hasValue)
+		{
+			const char* kernelName = argv[++n];
+			if (!SetInfluenceKernel(FindInfluenceKernel(kernelName)))
+			{
+				fprintf(stderr, "Influence kernel '%s' is not available\n", kernelName);
+				return 1;
+			}
+		}
+#endif
+		else if (!strcmp(argv[n], "--fixture") && hasValue)
+		{
+			n++;
+			for (int fixture = 0; fixture < Num_Fixtures; fixture++)
+			{
+				if (!strcmp(argv[n], GetFixtureName(fixture)))
+					onlyFixture = fixture;
+			}
+			if (onlyFixture == -1)
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+
+#ifdef USE_BUILDING_INDEX
+	InitInfluenceKernels();
+	printf("Influence kernel: %s\n", GetInfluenceKernelName(GetInfluenceKernel()));
+#endif
+
+	for (int fixture = 0; fixture < Num_Fixtures; fixture++)
+	{
+		if (onlyFixture == -1 || onlyFixture == fixture)
+		{
+			BuildFixture(fixture);
+			BenchmarkCity(GetFixtureName(fixture), iterations, results);
+		}
+	}
+
+	for (const char* loadFileName : loadFileNames)
+	{
+		InitGame();
+		SetSaveFileName(loadFileName);
+		if (!LoadCity())
+		{
+			fprintf(stderr, "Could not load city from %s\n", loadFileName);
+			return 1;
+		}
+		City.uiState.state = InGame;
+		ResetSimulationCaches();
+		CalculatePowerConnectivity();
+		ResetVisibleTileCache();
+
+		// Group names are kept short for the table
+		const char* name = strrchr(loadFileName, '/');
+		BenchmarkCity(name ? name + 1 : loadFileName, iterations, results);
+	}
+
+	PrintResultTable(results, "ns/op");
+
+	if (jsonFileName && !WriteResultJson(jsonFileName, "simulation", "ns/op", results))
+	{
+		fprintf(stderr, "Could not write %s\n", jsonFileName);
+		return 1;
+	}
+
+	return 0;
+}
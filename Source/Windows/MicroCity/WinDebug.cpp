@@ -1,6 +1,7 @@
 #include <SDL.h>
 #include "Defines.h"
 #include "Game.h"
+#include "City.h"
 
 #define DEBUG_ZOOM_SCALE 5
 
@@ -47,7 +48,7 @@ void DebugBuildingScore(Building* building, int score, int crime, int pollution,
 {
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		if (building == &State.buildings[n])
+		if (building == &City.state.buildings[n])
 		{
 			BuildingDebugValues[n].score = score;
 			BuildingDebugValues[n].crime = crime;
@@ -80,7 +81,7 @@ void UpdateDebugView()
 
 	for (int n = 0; n < MAX_BUILDINGS; n++)
 	{
-		Building* building = &State.buildings[n];
+		Building* building = &City.state.buildings[n];
 		if (building->type && !IsRubble(building->type))
 		{
 			Uint32 col = SDL_MapRGBA(DebugSurface->format, 0, 0, 0, 255);
@@ -1,9 +1,11 @@
 #include <SDL.h>
 #include <stdio.h>
+#include <time.h>
 #include <sstream>
 #include <iomanip>
 #include "Defines.h"
 #include "Game.h"
+#include "City.h"
 #include "Interface.h"
 #include "lodepng.h"
 #include "Simulation.h"
@@ -11,6 +13,7 @@
 
 #define ZOOM_SCALE 3
 #define SAVEGAME_NAME "savedcity.cty"
+#define FRAME_MILLISECONDS (1000 / 25)
 
 SDL_Window* AppWindow;
 SDL_Renderer* AppRenderer;
@@ -44,7 +47,7 @@ void SaveCity()
 
 	if (fopen_s(&fs, SAVEGAME_NAME, "wb") == 0)
 	{
-		fwrite(&State, sizeof(GameState), 1, fs);
+		fwrite(&City.state, sizeof(GameState), 1, fs);
 		fflush(fs);
 		fclose(fs);
 	}
@@ -56,12 +59,20 @@ bool LoadCity()
 
 	if (fopen_s(&fs, SAVEGAME_NAME, "rb") == 0)
 	{
-		fread(&State, sizeof(GameState), 1, fs);
+		size_t numRead = fread(&City.state, 1, sizeof(GameState), fs);
 		fclose(fs);
 
-		if (State.timeToNextDisaster > MAX_TIME_BETWEEN_DISASTERS)
+#ifdef USE_COUNTER_RNG
+		// Cities from before the random seed was added carry on using the LFSR
+		if (numRead == LEGACY_GAME_STATE_SIZE)
 		{
-			State.timeToNextDisaster = MIN_TIME_BETWEEN_DISASTERS;
+			City.state.randomSeed = 0;
+		}
+#endif
+
+		if (City.state.timeToNextDisaster > MAX_TIME_BETWEEN_DISASTERS)
+		{
+			City.state.timeToNextDisaster = MIN_TIME_BETWEEN_DISASTERS;
 		}
 		return true;
 	}
@@ -108,8 +119,12 @@ uint8_t GetInput()
 
 uint8_t* GetPowerGrid()
 {
+#ifdef USE_CITY_CONTEXT
+	return City.powerGrid;
+#else
 	static uint8_t PowerGrid[DISPLAY_WIDTH * DISPLAY_HEIGHT / 8];
 	return PowerGrid;
+#endif
 }
 
 int main(int argc, char* argv[])
@@ -129,13 +144,22 @@ int main(int argc, char* argv[])
 	);
 	ScreenTexture = SDL_CreateTexture(AppRenderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, ScreenSurface->w, ScreenSurface->h);
 
+#ifdef USE_COUNTER_RNG
+	// Every game gets a different city
+	SetNextCitySeed((uint32_t)time(nullptr) ^ (uint32_t)SDL_GetPerformanceCounter());
+#endif
 	InitGame();
+#ifdef USE_SIMULATION_SCHEDULER
+	// A quarter of each 25 fps frame, the power fill is split up when it won't fit
+	SetSimulationBudget(FRAME_MILLISECONDS * 1000 / 4, 1);
+#endif
 	
 	bool running = true;
-	int playRate = 1;
+	bool fastForward = false;
 
 	while (running)
 	{
+		Uint32 frameStart = SDL_GetTicks();
 		SDL_Event event;
 		while (SDL_PollEvent(&event))
 		{
@@ -161,13 +185,16 @@ int main(int argc, char* argv[])
 					SaveCity();
 					break;
 				case SDLK_F2:
-					LoadCity();
+					if (LoadCity())
+					{
+						ResetSimulationCaches();
+					}
 					break;
 				case SDLK_ESCAPE:
 					running = false;
 					break;
 				case SDLK_TAB:
-					playRate = 10;
+					fastForward = true;
 					break;
 				case SDLK_F12:
 					{
@@ -206,7 +233,7 @@ int main(int argc, char* argv[])
 					}
 				}
 				if (event.key.keysym.sym == SDLK_TAB)
-					playRate = 1;
+					fastForward = false;
 				break;
 			}
 		}
@@ -216,11 +243,14 @@ int main(int argc, char* argv[])
 
 		//memset(ScreenSurface->pixels, 0, ScreenSurface->format->BytesPerPixel * ScreenSurface->w * ScreenSurface->h);
 
-		for (int n = 0; n < playRate; n++)
+		// Holding tab spends most of the frame simulating, stopping if there is a fire or the budget comes up
+		if (fastForward)
 		{
-			TickGame();
+			FastForward(0xffff, 0, FRAME_MILLISECONDS * 3 / 4);
 		}
 
+		TickGame();
+
 		if (IsRecording)
 		{
 			std::ostringstream filename;
@@ -241,7 +271,12 @@ int main(int argc, char* argv[])
 		SDL_RenderCopy(AppRenderer, ScreenTexture, &src, &dest);
 		SDL_RenderPresent(AppRenderer);
 
-		SDL_Delay(1000 / 25);
+		// Only wait for whatever is left of the frame, fast forwarding will have used up most of it
+		Uint32 frameTime = SDL_GetTicks() - frameStart;
+		if (frameTime < FRAME_MILLISECONDS)
+		{
+			SDL_Delay(FRAME_MILLISECONDS - frameTime);
+		}
 
 		UpdateDebugView();
 	}